@@ -0,0 +1,72 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Массив из кусков по ChunkSize элементов, новые элементы равны T{}. Копия разделяет с оригиналом
+// куски, пока их не изменят: запись копирует только затронутый кусок, поэтому копия с одним
+// изменением стоит size() / ChunkSize указателей. Копировать и изменять массив может один поток,
+// читать и разрушать копии — любые
+template <typename T, size_t ChunkSize>
+class ChunkedArray {
+public:
+    size_t size() const {
+        return size_;
+    }
+
+    void Resize(size_t size) {
+        chunks_.resize((size + ChunkSize - 1) / ChunkSize);
+        size_ = size;
+    }
+
+    T operator[](size_t index) const {
+        const std::shared_ptr<Chunk>& chunk = chunks_[index / ChunkSize];
+        return chunk ? (*chunk)[index % ChunkSize] : T{};
+    }
+
+    // Кусок, который делят с другими копиями, сначала копируется
+    T& MutableAt(size_t index) {
+        std::shared_ptr<Chunk>& chunk = chunks_[index / ChunkSize];
+        if (!chunk) {
+            chunk = std::make_shared<Chunk>();
+        }
+        // Счётчик ссылок может только уменьшиться параллельно: новые ссылки появляются
+        // лишь при копировании массива, а его копирует тот же поток
+        else if (chunk.use_count() > 1) {
+            chunk = std::make_shared<Chunk>(*chunk);
+        }
+        return (*chunk)[index % ChunkSize];
+    }
+
+private:
+    using Chunk = std::array<T, ChunkSize>;
+
+    // Пустой указатель — кусок из T{}
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    size_t size_ = 0;
+};
+
+// Множество внутренних номеров документов, копии которого разделяют неизменённые части
+class ChunkedBitmap {
+public:
+    // Новые номера считаются отсутствующими
+    void Resize(size_t ordinal_count) {
+        words_.Resize((ordinal_count + 63) / 64);
+    }
+
+    void Set(int ordinal) {
+        words_.MutableAt(static_cast<size_t>(ordinal) >> 6) |= uint64_t{ 1 } << (ordinal & 63);
+    }
+
+    // Номера за пределами карты считаются отсутствующими
+    bool Test(int ordinal) const {
+        const size_t word = static_cast<size_t>(ordinal) >> 6;
+        return word < words_.size() && (words_[word] >> (ordinal & 63) & 1) != 0;
+    }
+
+private:
+    // 4096 номеров в куске
+    ChunkedArray<uint64_t, 64> words_;
+};
@@ -1,48 +1,191 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
 
-template <typename Key, typename Value>
+// Размер кеш-линии: соседние шарды не должны делить линию, иначе потоки,
+// работающие с разными шардами, всё равно мешают друг другу
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Хеш-таблица, разбитая на шарды с отдельными мьютексами.
+// Внутри шарда — открытая адресация с линейным пробированием
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
 class ConcurrentMap {
 private:
-    struct Bucket {
+    struct Slot {
+        Key key{};
+        Value value{};
+        bool used = false;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
         std::mutex mutex;
-        std::map<Key, Value> map;
+        std::vector<Slot> slots;
+        size_t size = 0;
     };
 
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
-
+    // Пока объект жив, шард с ключом заблокирован
     struct Access {
         std::lock_guard<std::mutex> guard;
         Value& ref_to_value;
 
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mutex)
-            , ref_to_value(bucket.map[key]) {
+        Access(const Key& key, uint64_t hash, Shard& shard)
+            : guard(shard.mutex)
+            , ref_to_value(FindOrInsert(shard, key, hash).value) {
         }
     };
 
-    explicit ConcurrentMap(size_t bucket_count)
-        : buckets_(bucket_count) {
+    explicit ConcurrentMap(size_t shard_count)
+        : shards_(shard_count) {
     }
 
     Access operator[](const Key& key) {
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        return { key, bucket };
+        const uint64_t hash = HashOf(key);
+        return { key, hash, ShardOf(hash) };
+    }
+
+    // Возвращает false, если ключа не было
+    bool erase(const Key& key) {
+        const uint64_t hash = HashOf(key);
+        Shard& shard = ShardOf(hash);
+        std::lock_guard guard(shard.mutex);
+        if (shard.slots.empty()) {
+            return false;
+        }
+        const size_t mask = shard.slots.size() - 1;
+        size_t slot = hash & mask;
+        for (; shard.slots[slot].used; slot = (slot + 1) & mask) {
+            if (shard.slots[slot].key == key) {
+                EraseSlot(shard, slot);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Обходит все пары, блокируя шарды по очереди
+    template <typename Function>
+    void ForEach(Function function) {
+        for (Shard& shard : shards_) {
+            std::lock_guard guard(shard.mutex);
+            for (Slot& slot : shard.slots) {
+                if (slot.used) {
+                    function(static_cast<const Key&>(slot.key), slot.value);
+                }
+            }
+        }
+    }
+
+    // Передаёт все пары в function и очищает таблицу
+    template <typename Function>
+    void Drain(Function function) {
+        for (Shard& shard : shards_) {
+            std::vector<Slot> slots;
+            {
+                std::lock_guard guard(shard.mutex);
+                slots.swap(shard.slots);
+                shard.size = 0;
+            }
+            for (Slot& slot : slots) {
+                if (slot.used) {
+                    function(std::move(slot.key), std::move(slot.value));
+                }
+            }
+        }
+    }
+
+    size_t size() {
+        size_t result = 0;
+        for (Shard& shard : shards_) {
+            std::lock_guard guard(shard.mutex);
+            result += shard.size;
+        }
+        return result;
     }
 
     std::map<Key, Value> BuildOrdinaryMap() {
         std::map<Key, Value> result;
-        for (auto& [mutex, map] : buckets_) {
-            std::lock_guard g(mutex);
-            result.insert(map.begin(), map.end());
+        ForEach([&result](const Key& key, const Value& value) {
+            result.emplace(key, value);
+            });
+        return result;
+    }
+
+private:
+    static constexpr size_t INITIAL_SLOT_COUNT = 16;
+
+    std::vector<Shard> shards_;
+
+    // Перемешивание (splitmix64): младшие биты идут на слот, старшие — на выбор шарда
+    static uint64_t HashOf(const Key& key) {
+        uint64_t hash = static_cast<uint64_t>(Hash{}(key));
+        hash ^= hash >> 30;
+        hash *= 0xbf58476d1ce4e5b9ULL;
+        hash ^= hash >> 27;
+        hash *= 0x94d049bb133111ebULL;
+        hash ^= hash >> 31;
+        return hash;
+    }
+
+    Shard& ShardOf(uint64_t hash) {
+        return shards_[(hash >> 32) % shards_.size()];
+    }
+
+    static Slot& FindOrInsert(Shard& shard, const Key& key, uint64_t hash) {
+        // Заполненность не выше половины
+        if ((shard.size + 1) * 2 > shard.slots.size()) {
+            Grow(shard);
+        }
+        const size_t mask = shard.slots.size() - 1;
+        size_t slot = hash & mask;
+        for (; shard.slots[slot].used; slot = (slot + 1) & mask) {
+            if (shard.slots[slot].key == key) {
+                return shard.slots[slot];
+            }
         }
+        Slot& result = shard.slots[slot];
+        result.key = key;
+        result.value = Value{};
+        result.used = true;
+        ++shard.size;
         return result;
     }
 
-    void erase(Key key) {
-        buckets_[static_cast<uint64_t>(key) % buckets_.size()].map.erase(key);
+    static void Grow(Shard& shard) {
+        std::vector<Slot> old_slots(std::max(INITIAL_SLOT_COUNT, shard.slots.size() * 2));
+        old_slots.swap(shard.slots);
+        const size_t mask = shard.slots.size() - 1;
+        for (Slot& old_slot : old_slots) {
+            if (!old_slot.used) {
+                continue;
+            }
+            size_t slot = HashOf(old_slot.key) & mask;
+            while (shard.slots[slot].used) {
+                slot = (slot + 1) & mask;
+            }
+            shard.slots[slot] = std::move(old_slot);
+        }
     }
 
-private:
-    std::vector<Bucket> buckets_;
+    // Удаление со сдвигом назад: следующие элементы цепочки переезжают ближе
+    // к своим позициям, поэтому надгробия не нужны
+    static void EraseSlot(Shard& shard, size_t slot) {
+        const size_t mask = shard.slots.size() - 1;
+        size_t hole = slot;
+        for (size_t next = (hole + 1) & mask; shard.slots[next].used; next = (next + 1) & mask) {
+            const size_t home = HashOf(shard.slots[next].key) & mask;
+            // Элемент можно перенести в дыру, если его домашняя позиция не лежит между дырой и им
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                shard.slots[hole] = std::move(shard.slots[next]);
+                hole = next;
+            }
+        }
+        shard.slots[hole] = Slot{};
+        --shard.size;
+    }
 };
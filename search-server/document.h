@@ -1,5 +1,9 @@
 #pragma once
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
 
 struct Document {
     Document();
@@ -11,6 +15,16 @@ struct Document {
     int rating = 0;
 };
 
+// 128-битный отпечаток множества слов документа
+struct DocumentFingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const DocumentFingerprint& other) const {
+        return low == other.low && high == other.high;
+    }
+};
+
 enum class DocumentStatus {
     ACTUAL,
     IRRELEVANT,
@@ -18,4 +32,20 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// Документ для пакетного добавления; текст должен жить до конца вызова AddDocuments
+struct DocumentToAdd {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+// Документ пакета, который не удалось добавить: index — его позиция в пакете,
+// message — текст исключения, которое бросил бы AddDocument
+struct AddDocumentError {
+    size_t index = 0;
+    int document_id = 0;
+    std::string message;
+};
+
 std::ostream& operator<<(std::ostream& out, Document doc);
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Множество внутренних номеров документов в виде битовой карты
+class DocumentBitmap {
+public:
+    DocumentBitmap() = default;
+
+    explicit DocumentBitmap(size_t ordinal_count)
+        : words_((ordinal_count + 63) / 64, 0) {
+    }
+
+    // Новые номера считаются отсутствующими
+    void Resize(size_t ordinal_count) {
+        words_.resize((ordinal_count + 63) / 64, 0);
+    }
+
+    void Set(int ordinal) {
+        words_[static_cast<size_t>(ordinal) >> 6] |= uint64_t{ 1 } << (ordinal & 63);
+    }
+
+    void Reset(int ordinal) {
+        words_[static_cast<size_t>(ordinal) >> 6] &= ~(uint64_t{ 1 } << (ordinal & 63));
+    }
+
+    // Номера за пределами карты считаются отсутствующими
+    bool Test(int ordinal) const {
+        const size_t word = static_cast<size_t>(ordinal) >> 6;
+        return word < words_.size() && (words_[word] >> (ordinal & 63) & 1) != 0;
+    }
+
+    bool empty() const {
+        return words_.empty();
+    }
+
+private:
+    std::vector<uint64_t> words_;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Массив, данные которого лежат во внешней памяти (отображённый снимок индекса) или в собственном векторе.
+// Чтение внешних данных их не копирует; любой неконстантный доступ сначала копирует их в вектор
+template <typename T>
+class ExternalArray {
+public:
+    // Данные не копируются и должны жить, пока массив не изменят
+    void AssignExternal(const T* data, size_t size) {
+        std::vector<T>().swap(values_);
+        external_ = data;
+        external_size_ = size;
+    }
+
+    bool IsExternal() const {
+        return external_ != nullptr;
+    }
+
+    const T* data() const {
+        return external_ != nullptr ? external_ : values_.data();
+    }
+
+    size_t size() const {
+        return external_ != nullptr ? external_size_ : values_.size();
+    }
+
+    const T& operator[](size_t index) const {
+        return data()[index];
+    }
+
+    T& operator[](size_t index) {
+        return Values()[index];
+    }
+
+    void push_back(const T& value) {
+        Values().push_back(value);
+    }
+
+    // Собственный вектор с данными массива
+    std::vector<T>& Values() {
+        if (external_ != nullptr) {
+            values_.assign(external_, external_ + external_size_);
+            external_ = nullptr;
+            external_size_ = 0;
+        }
+        return values_;
+    }
+
+private:
+    std::vector<T> values_;
+    const T* external_ = nullptr;
+    size_t external_size_ = 0;
+};
@@ -0,0 +1,105 @@
+#include "index_segment.h"
+#include <algorithm>
+using namespace std;
+
+void IndexSegment::AddDocument(int document_id, DocumentStatus status, int rating, int word_count,
+    const vector<pair<string_view, uint32_t>>& term_counts) {
+    const int ordinal = static_cast<int>(document_ids_.size());
+    document_ids_.push_back(document_id);
+    statuses_.push_back(status);
+    ratings_.push_back(rating);
+    word_counts_.push_back(word_count);
+
+    vector<pair<TermId, uint32_t>> terms;
+    terms.reserve(term_counts.size());
+    for (const auto& [term, count] : term_counts) {
+        terms.emplace_back(dictionary_.Intern(term), count);
+    }
+    AddTerms(ordinal, terms);
+}
+
+void IndexSegment::AppendDocuments(const IndexSegment& source, const ChunkedBitmap& deleted) {
+    vector<TermId> term_ids(source.dictionary_.size(), INVALID_TERM_ID);
+    vector<pair<TermId, uint32_t>> terms;
+    for (int source_ordinal = 0; source_ordinal < static_cast<int>(source.size()); ++source_ordinal) {
+        if (deleted.Test(source_ordinal)) {
+            continue;
+        }
+        const int ordinal = static_cast<int>(document_ids_.size());
+        document_ids_.push_back(source.document_ids_[source_ordinal]);
+        statuses_.push_back(source.statuses_[source_ordinal]);
+        ratings_.push_back(source.ratings_[source_ordinal]);
+        word_counts_.push_back(source.word_counts_[source_ordinal]);
+
+        terms.clear();
+        for (uint64_t i = source.forward_offsets_[source_ordinal]; i < source.forward_offsets_[source_ordinal + 1]; ++i) {
+            TermId& term_id = term_ids[source.forward_terms_[i]];
+            if (term_id == INVALID_TERM_ID) {
+                term_id = dictionary_.Intern(source.dictionary_.GetTerm(source.forward_terms_[i]));
+                // Если слово есть в нескольких источниках, номер берётся из последнего: у живых документов он один
+                global_term_ids_.resize(dictionary_.size(), INVALID_TERM_ID);
+                global_term_ids_[term_id] = source.global_term_ids_[source.forward_terms_[i]];
+            }
+            terms.emplace_back(term_id, source.forward_counts_[i]);
+        }
+        AddTerms(ordinal, terms);
+    }
+}
+
+void IndexSegment::AddTerms(int ordinal, vector<pair<TermId, uint32_t>>& terms) {
+    if (postings_.size() < dictionary_.size()) {
+        postings_.resize(dictionary_.size());
+    }
+    sort(terms.begin(), terms.end());
+    // Частота считается так же, как в SearchServer::AddDocument, чтобы релевантность совпадала
+    const double inv_word_count = 1.0 / word_counts_[ordinal];
+    for (const auto& [term_id, count] : terms) {
+        postings_[term_id].Insert(ordinal, count * inv_word_count);
+        forward_terms_.push_back(term_id);
+        forward_counts_.push_back(count);
+    }
+    forward_offsets_.push_back(forward_terms_.size());
+}
+
+void IndexSegment::Seal() {
+    if (sealed_) {
+        return;
+    }
+    for (PostingList& postings : postings_) {
+        postings.Compress(word_counts_.data());
+    }
+    sorted_documents_.reserve(document_ids_.size());
+    for (int ordinal = 0; ordinal < static_cast<int>(document_ids_.size()); ++ordinal) {
+        sorted_documents_.emplace_back(document_ids_[ordinal], ordinal);
+    }
+    sort(sorted_documents_.begin(), sorted_documents_.end());
+    for (auto* values : { &document_ids_, &ratings_, &word_counts_ }) {
+        values->shrink_to_fit();
+    }
+    statuses_.shrink_to_fit();
+    postings_.shrink_to_fit();
+    global_term_ids_.resize(dictionary_.size(), INVALID_TERM_ID);
+    forward_offsets_.shrink_to_fit();
+    forward_terms_.shrink_to_fit();
+    forward_counts_.shrink_to_fit();
+    sealed_ = true;
+}
+
+int IndexSegment::FindOrdinal(int document_id, const ChunkedBitmap& deleted) const {
+    if (!sealed_) {
+        // Незапечатанный сегмент мал, отдельный индекс по id для него не строится
+        for (int ordinal = 0; ordinal < static_cast<int>(document_ids_.size()); ++ordinal) {
+            if (document_ids_[ordinal] == document_id && !deleted.Test(ordinal)) {
+                return ordinal;
+            }
+        }
+        return -1;
+    }
+    for (auto it = lower_bound(sorted_documents_.begin(), sorted_documents_.end(), pair{ document_id, 0 });
+        it != sorted_documents_.end() && it->first == document_id; ++it) {
+        if (!deleted.Test(it->second)) {
+            return it->second;
+        }
+    }
+    return -1;
+}
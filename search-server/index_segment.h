@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "chunked_array.h"
+#include "document.h"
+#include "posting_list.h"
+#include "term_dictionary.h"
+
+// Сегмент индекса: свой словарь, списки документов слов и прямой индекс для документов
+// с внутренними номерами 0..size()-1. Пока сегмент не запечатан, в него добавляются документы;
+// Seal сжимает списки и уплотняет данные, после чего сегмент не меняется,
+// и его константные методы можно вызывать из любых потоков без блокировок
+class IndexSegment {
+public:
+    IndexSegment() = default;
+
+    IndexSegment(const IndexSegment&) = delete;
+    IndexSegment& operator=(const IndexSegment&) = delete;
+
+    // term_counts — различные слова документа и число их вхождений, word_count — всего слов
+    void AddDocument(int document_id, DocumentStatus status, int rating, int word_count,
+        const std::vector<std::pair<std::string_view, uint32_t>>& term_counts);
+
+    // Добавляет неудалённые документы другого сегмента; слова source переводятся в свои один раз на слово
+    void AppendDocuments(const IndexSegment& source, const ChunkedBitmap& deleted);
+
+    // Запоминает общие номера слов: find(слово) — номер слова в общем словаре индекса.
+    // Вызывается перед запечатыванием; слияние переносит номера из исходных сегментов
+    template <typename FindGlobalTermId>
+    void AssignGlobalTermIds(FindGlobalTermId find) {
+        global_term_ids_.resize(dictionary_.size());
+        for (TermId term_id = 0; term_id < dictionary_.size(); ++term_id) {
+            global_term_ids_[term_id] = find(dictionary_.GetTerm(term_id));
+        }
+    }
+
+    void Seal();
+
+    bool IsSealed() const {
+        return sealed_;
+    }
+
+    size_t size() const {
+        return document_ids_.size();
+    }
+
+    // Внутренний номер неудалённого документа с этим id или -1. Удалённые документы остаются
+    // в сегменте до слияния, поэтому один id может встречаться несколько раз
+    int FindOrdinal(int document_id, const ChunkedBitmap& deleted) const;
+
+    // INVALID_TERM_ID, если слова в сегменте нет
+    TermId FindTerm(std::string_view term) const {
+        return dictionary_.Find(term);
+    }
+
+    // Граница номеров слов сегмента
+    size_t GetTermCount() const {
+        return dictionary_.size();
+    }
+
+    // Общий номер слова на момент запечатывания. Номер слова, все документы с которым удалены,
+    // мог быть выдан другому слову
+    TermId GetGlobalTermId(TermId term_id) const {
+        return global_term_ids_[term_id];
+    }
+
+    const PostingList& GetPostings(TermId term_id) const {
+        return postings_[term_id];
+    }
+
+    const int* GetWordCounts() const {
+        return word_counts_.data();
+    }
+
+    int GetDocumentId(int ordinal) const {
+        return document_ids_[ordinal];
+    }
+
+    DocumentStatus GetStatus(int ordinal) const {
+        return statuses_[ordinal];
+    }
+
+    int GetRating(int ordinal) const {
+        return ratings_[ordinal];
+    }
+
+    int GetWordCount(int ordinal) const {
+        return word_counts_[ordinal];
+    }
+
+    // Вызывает function(слово, вхождения) для каждого различного слова документа
+    template <typename Function>
+    void ForEachTerm(int ordinal, Function function) const {
+        for (uint64_t i = forward_offsets_[ordinal]; i < forward_offsets_[ordinal + 1]; ++i) {
+            function(dictionary_.GetTerm(forward_terms_[i]), forward_counts_[i]);
+        }
+    }
+
+    // То же, но с номером слова в сегменте вместо слова
+    template <typename Function>
+    void ForEachTermId(int ordinal, Function function) const {
+        for (uint64_t i = forward_offsets_[ordinal]; i < forward_offsets_[ordinal + 1]; ++i) {
+            function(forward_terms_[i], forward_counts_[i]);
+        }
+    }
+
+private:
+    bool sealed_ = false;
+    TermDictionary dictionary_;
+    std::vector<PostingList> postings_;
+    std::vector<TermId> global_term_ids_;
+
+    std::vector<int> document_ids_;
+    std::vector<DocumentStatus> statuses_;
+    std::vector<int> ratings_;
+    std::vector<int> word_counts_;
+    // Слова документа по возрастанию номера и их вхождения: [forward_offsets_[i], forward_offsets_[i + 1])
+    std::vector<uint64_t> forward_offsets_{ 0 };
+    std::vector<TermId> forward_terms_;
+    std::vector<uint32_t> forward_counts_;
+    // (id документа, внутренний номер) по возрастанию id; заполняется при запечатывании
+    std::vector<std::pair<int, int>> sorted_documents_;
+
+    // Записывает слова документа ordinal в списки и прямой индекс; terms сортируется
+    void AddTerms(int ordinal, std::vector<std::pair<TermId, uint32_t>>& terms);
+};
@@ -1,5 +1,6 @@
 #include "process_queries.h"
 #include "search_server.h"
+#include "test_example_functions.h"
 #include <execution>
 #include <iostream>
 #include <string>
@@ -12,6 +13,14 @@ void PrintDocument(const Document& document) {
         << "rating = "s << document.rating << " }"s << endl;
 }
 int main() {
+    // Проверки и замеры долгие и пишут файлы в текущий каталог, поэтому собираются только по флагам
+#ifdef SEARCH_SERVER_RUN_TESTS
+    TestSearchServer();
+#endif
+#ifdef SEARCH_SERVER_RUN_BENCHMARKS
+    RunBenchmarks(cout);
+    return 0;
+#endif
     SearchServer search_server("and with"s);
     int id = 0;
     for (
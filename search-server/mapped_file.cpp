@@ -0,0 +1,110 @@
+#include "mapped_file.h"
+#include <cstdio>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+void ReplaceFileDurably(const string& source, const string& target) {
+    const HANDLE file = CreateFileA(source.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw runtime_error("Cannot open "s + source);
+    }
+    const bool flushed = FlushFileBuffers(file) != 0;
+    CloseHandle(file);
+    if (!flushed || !MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        throw runtime_error("Cannot replace "s + target);
+    }
+}
+
+MappedFile::MappedFile(const string& path) {
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+        throw runtime_error("Cannot open "s + path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+        CloseHandle(file_);
+        throw runtime_error("Cannot map "s + path);
+    }
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping_ != nullptr ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr) {
+        if (mapping_ != nullptr) {
+            CloseHandle(mapping_);
+        }
+        CloseHandle(file_);
+        throw runtime_error("Cannot map "s + path);
+    }
+    data_ = static_cast<const char*>(view);
+    size_ = static_cast<size_t>(size.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+}
+
+#else
+
+void ReplaceFileDurably(const string& source, const string& target) {
+    const int file = open(source.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw runtime_error("Cannot open "s + source);
+    }
+    const bool synced = fsync(file) == 0;
+    close(file);
+    if (!synced || rename(source.c_str(), target.c_str()) != 0) {
+        throw runtime_error("Cannot replace "s + target);
+    }
+    // Переименование попадает на диск вместе с каталогом
+    const size_t slash = target.find_last_of('/');
+    const string directory = slash == string::npos ? "."s : slash == 0 ? "/"s : target.substr(0, slash);
+    const int directory_file = open(directory.c_str(), O_RDONLY);
+    if (directory_file >= 0) {
+        fsync(directory_file);
+        close(directory_file);
+    }
+}
+
+MappedFile::MappedFile(const string& path) {
+    file_ = open(path.c_str(), O_RDONLY);
+    if (file_ < 0) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    struct stat status;
+    if (fstat(file_, &status) != 0 || status.st_size == 0) {
+        close(file_);
+        throw runtime_error("Cannot map "s + path);
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, file_, 0);
+    if (view == MAP_FAILED) {
+        close(file_);
+        throw runtime_error("Cannot map "s + path);
+    }
+    data_ = static_cast<const char*>(view);
+    size_ = static_cast<size_t>(status.st_size);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<char*>(data_), size_);
+    close(file_);
+}
+
+#endif
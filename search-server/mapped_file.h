@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Сбрасывает source на диск и атомарно заменяет им target: после сбоя на месте target
+// остаётся либо старый, либо новый файл целиком. Бросает std::runtime_error
+void ReplaceFileDurably(const std::string& source, const std::string& target);
+
+// Файл, отображённый в память только для чтения. Страницы подгружаются системой при первом обращении
+class MappedFile {
+public:
+    // Бросает std::runtime_error, если файл не удалось открыть или отобразить
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#else
+    int file_ = -1;
+#endif
+};
@@ -0,0 +1,104 @@
+#include "minhash_index.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+using namespace std;
+
+namespace {
+
+uint64_t MixHash(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+}  // namespace
+
+MinHashIndex::MinHashIndex(double jaccard_threshold) {
+    if (!(jaccard_threshold > 0.0 && jaccard_threshold <= 1.0)) {
+        throw invalid_argument("Jaccard threshold must be in (0, 1]"s);
+    }
+    for (size_t rows = MINHASH_SIGNATURE_SIZE; rows > 1; --rows) {
+        const size_t bands = MINHASH_SIGNATURE_SIZE / rows;
+        if (1.0 - pow(1.0 - pow(jaccard_threshold, static_cast<double>(rows)), static_cast<double>(bands))
+            >= MINHASH_MIN_CANDIDATE_PROBABILITY) {
+            rows_per_band_ = rows;
+            break;
+        }
+    }
+    band_count_ = MINHASH_SIGNATURE_SIZE / rows_per_band_;
+    buckets_.resize(band_count_);
+
+    // Постоянное зерно: сигнатуры одного и того же текста совпадают между запусками
+    mt19937_64 generator(0x5eed);
+    multipliers_.resize(MINHASH_SIGNATURE_SIZE);
+    increments_.resize(MINHASH_SIGNATURE_SIZE);
+    for (size_t i = 0; i < MINHASH_SIGNATURE_SIZE; ++i) {
+        multipliers_[i] = generator() | 1;
+        increments_[i] = generator();
+    }
+}
+
+void MinHashIndex::AddWord(Signature& signature, string_view word) const {
+    const uint64_t hash = MixHash(std::hash<string_view>{}(word));
+    for (size_t i = 0; i < MINHASH_SIGNATURE_SIZE; ++i) {
+        signature[i] = min(signature[i], static_cast<uint32_t>((multipliers_[i] * hash + increments_[i]) >> 32));
+    }
+}
+
+vector<uint64_t> MinHashIndex::ComputeBandKeys(const Signature& signature) const {
+    vector<uint64_t> keys(band_count_);
+    for (size_t band = 0; band < band_count_; ++band) {
+        uint64_t key = MixHash(band);
+        for (size_t row = 0; row < rows_per_band_; ++row) {
+            key = MixHash(key ^ signature[band * rows_per_band_ + row]);
+        }
+        keys[band] = key;
+    }
+    return keys;
+}
+
+vector<int> MinHashIndex::FindCandidates(const Signature& signature) const {
+    const vector<uint64_t> keys = ComputeBandKeys(signature);
+    vector<int> candidates;
+    for (size_t band = 0; band < band_count_; ++band) {
+        const auto it = buckets_[band].find(keys[band]);
+        if (it != buckets_[band].end()) {
+            candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+    return candidates;
+}
+
+void MinHashIndex::Add(int document_id, const Signature& signature) {
+    Remove(document_id);
+    vector<uint64_t> keys = ComputeBandKeys(signature);
+    for (size_t band = 0; band < band_count_; ++band) {
+        buckets_[band][keys[band]].push_back(document_id);
+    }
+    document_bands_.emplace(document_id, move(keys));
+}
+
+void MinHashIndex::Remove(int document_id) {
+    const auto it = document_bands_.find(document_id);
+    if (it == document_bands_.end()) {
+        return;
+    }
+    for (size_t band = 0; band < band_count_; ++band) {
+        auto bucket = buckets_[band].find(it->second[band]);
+        auto& documents = bucket->second;
+        documents.erase(find(documents.begin(), documents.end(), document_id));
+        if (documents.empty()) {
+            buckets_[band].erase(bucket);
+        }
+    }
+    document_bands_.erase(it);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Число значений MinHash в сигнатуре документа
+constexpr size_t MINHASH_SIGNATURE_SIZE = 128;
+// С какой вероятностью пара со сходством не ниже порога должна попасть в кандидаты
+constexpr double MINHASH_MIN_CANDIDATE_PROBABILITY = 0.99;
+
+// Поиск кандидатов в почти дубликаты методом MinHash с LSH-бандами. Сигнатура разбивается на банды
+// по rows значений; документы, у которых совпала хотя бы одна банда, — кандидаты. Пара со сходством
+// Жаккара s попадает в кандидаты с вероятностью 1 - (1 - s^rows)^bands, поэтому ищутся только
+// документы из тех же корзин, а не все пары. Кандидатов нужно проверять точным сходством.
+// Не потокобезопасен, кроме константных методов
+class MinHashIndex {
+public:
+    using Signature = std::vector<uint32_t>;
+
+    // Банды подбираются под порог сходства Жаккара: самые длинные банды, при которых пара
+    // со сходством jaccard_threshold попадает в кандидаты с вероятностью MINHASH_MIN_CANDIDATE_PROBABILITY
+    explicit MinHashIndex(double jaccard_threshold);
+
+    size_t GetBandCount() const {
+        return band_count_;
+    }
+
+    size_t GetRowsPerBand() const {
+        return rows_per_band_;
+    }
+
+    // Сигнатура множества слов; повторы слов на неё не влияют
+    template <typename Words>
+    Signature ComputeSignature(const Words& words) const;
+
+    // Документы, у которых с сигнатурой совпала хотя бы одна банда, по возрастанию id
+    std::vector<int> FindCandidates(const Signature& signature) const;
+
+    // Повторное добавление документа заменяет его сигнатуру
+    void Add(int document_id, const Signature& signature);
+    void Remove(int document_id);
+
+private:
+    size_t rows_per_band_ = 1;
+    size_t band_count_ = MINHASH_SIGNATURE_SIZE;
+    // Коэффициенты хеш-функций a * x + b (a нечётные); значение — старшие 32 бита
+    std::vector<uint64_t> multipliers_;
+    std::vector<uint64_t> increments_;
+    // По номеру банды: ключ банды -> документы
+    std::vector<std::unordered_map<uint64_t, std::vector<int>>> buckets_;
+    // Ключи банд добавленных документов
+    std::unordered_map<int, std::vector<uint64_t>> document_bands_;
+
+    void AddWord(Signature& signature, std::string_view word) const;
+    std::vector<uint64_t> ComputeBandKeys(const Signature& signature) const;
+};
+
+template <typename Words>
+MinHashIndex::Signature MinHashIndex::ComputeSignature(const Words& words) const {
+    Signature signature(MINHASH_SIGNATURE_SIZE, UINT32_MAX);
+    for (const std::string_view word : words) {
+        AddWord(signature, word);
+    }
+    return signature;
+}
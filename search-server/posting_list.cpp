@@ -0,0 +1,239 @@
+#include "posting_list.h"
+#include "stream_vbyte.h"
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+void PostingList::Insert(int document_id, double term_freq) {
+    // Документы обычно добавляются по возрастанию id, поэтому сначала проверяем хвост
+    if (document_ids_.empty() || document_ids_.back() < document_id) {
+        document_ids_.push_back(document_id);
+        term_freqs_.push_back(term_freq);
+        max_term_freq_ = max(max_term_freq_, term_freq);
+        return;
+    }
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    const auto pos = it - document_ids_.begin();
+    if (it != document_ids_.end() && *it == document_id) {
+        term_freqs_[pos] += term_freq;
+        max_term_freq_ = max(max_term_freq_, term_freqs_[pos]);
+        return;
+    }
+    document_ids_.insert(it, document_id);
+    term_freqs_.insert(term_freqs_.begin() + pos, term_freq);
+    max_term_freq_ = max(max_term_freq_, term_freq);
+}
+
+void PostingList::InsertSorted(const pair<int, double>* postings, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    const size_t old_size = document_ids_.size();
+    for (size_t i = 0; i < count; ++i) {
+        document_ids_.push_back(postings[i].first);
+        term_freqs_.push_back(postings[i].second);
+        max_term_freq_ = max(max_term_freq_, postings[i].second);
+    }
+    if (old_size == 0 || document_ids_[old_size - 1] < postings[0].first) {
+        return;
+    }
+    // Новые документы заняли номера удалённых: сливаем две отсортированные половины
+    vector<int> merged_ids;
+    vector<double> merged_freqs;
+    merged_ids.reserve(document_ids_.size());
+    merged_freqs.reserve(document_ids_.size());
+    size_t left = 0;
+    size_t right = old_size;
+    while (left < old_size || right < document_ids_.size()) {
+        const size_t pos = right == document_ids_.size()
+            || (left < old_size && document_ids_[left] < document_ids_[right]) ? left++ : right++;
+        merged_ids.push_back(document_ids_[pos]);
+        merged_freqs.push_back(term_freqs_[pos]);
+    }
+    document_ids_.swap(merged_ids);
+    term_freqs_.swap(merged_freqs);
+}
+
+bool PostingList::Erase(int document_id) {
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (it == document_ids_.end() || *it != document_id) {
+        return false;
+    }
+    const auto freq_it = term_freqs_.begin() + (it - document_ids_.begin());
+    const bool was_max = *freq_it >= max_term_freq_;
+    term_freqs_.erase(freq_it);
+    document_ids_.erase(it);
+    if (was_max) {
+        max_term_freq_ = term_freqs_.empty() ? 0.0 : *max_element(term_freqs_.begin(), term_freqs_.end());
+    }
+    return true;
+}
+
+size_t PostingList::EraseDocuments(const DocumentBitmap& removed) {
+    size_t kept = 0;
+    max_term_freq_ = 0.0;
+    for (size_t i = 0; i < document_ids_.size(); ++i) {
+        if (removed.Test(document_ids_[i])) {
+            continue;
+        }
+        document_ids_[kept] = document_ids_[i];
+        term_freqs_[kept] = term_freqs_[i];
+        max_term_freq_ = max(max_term_freq_, term_freqs_[i]);
+        ++kept;
+    }
+    const size_t erased = document_ids_.size() - kept;
+    document_ids_.resize(kept);
+    term_freqs_.resize(kept);
+    return erased;
+}
+
+bool PostingList::Contains(int document_id) const {
+    if (!IsCompressed()) {
+        return binary_search(document_ids_.begin(), document_ids_.end(), document_id);
+    }
+    const Block* blocks = Blocks();
+    const Block* it = lower_bound(blocks, blocks + BlockCount(), document_id,
+        [](const Block& block, int value) { return block.last_document_id < value; });
+    if (it == blocks + BlockCount()) {
+        return false;
+    }
+    uint32_t document_ids[POSTING_BLOCK_SIZE];
+    DecodeDocumentIds(it - blocks, document_ids);
+    return binary_search(document_ids, document_ids + it->size, static_cast<uint32_t>(document_id));
+}
+
+void PostingList::Compress(const int* word_counts) {
+    if (IsCompressed() || document_ids_.empty()) {
+        return;
+    }
+    vector<uint32_t> document_ids(POSTING_BLOCK_SIZE);
+    vector<uint32_t> counts(POSTING_BLOCK_SIZE);
+    uint32_t previous = 0;
+    for (size_t begin = 0; begin < document_ids_.size(); begin += POSTING_BLOCK_SIZE) {
+        const size_t size = min(POSTING_BLOCK_SIZE, document_ids_.size() - begin);
+        // Хвост блока дополняется до кратного четырём: повтор последнего id и нулевые вхождения
+        const size_t padded_size = (size + 3) & ~size_t{ 3 };
+        for (size_t i = 0; i < padded_size; ++i) {
+            const size_t pos = begin + min(i, size - 1);
+            const int document_id = document_ids_[pos];
+            document_ids[i] = static_cast<uint32_t>(document_id);
+            counts[i] = i < size ? static_cast<uint32_t>(llround(term_freqs_[pos] * word_counts[document_id])) : 0;
+        }
+        blocks_.push_back({ document_ids_[begin + size - 1], static_cast<uint32_t>(data_.size()), static_cast<uint32_t>(size) });
+        StreamVByteEncodeDelta(document_ids.data(), padded_size, previous, data_);
+        StreamVByteEncode(counts.data(), padded_size, data_);
+        previous = document_ids[size - 1];
+    }
+    data_.resize(data_.size() + STREAM_VBYTE_PADDING, 0);
+    data_.shrink_to_fit();
+    blocks_.shrink_to_fit();
+    compressed_size_ = document_ids_.size();
+    vector<int>().swap(document_ids_);
+    vector<double>().swap(term_freqs_);
+}
+
+void PostingList::Decompress(const int* word_counts) {
+    if (!IsCompressed()) {
+        return;
+    }
+    vector<int> document_ids;
+    vector<double> term_freqs;
+    document_ids.reserve(compressed_size_);
+    term_freqs.reserve(compressed_size_);
+    for (PostingCursor cursor(*this, word_counts); !cursor.AtEnd(); cursor.Next()) {
+        document_ids.push_back(cursor.Ordinal());
+        term_freqs.push_back(cursor.TermFreq());
+    }
+    document_ids_.swap(document_ids);
+    term_freqs_.swap(term_freqs);
+    vector<Block>().swap(blocks_);
+    vector<uint8_t>().swap(data_);
+    compressed_size_ = 0;
+    external_blocks_ = nullptr;
+    external_block_count_ = 0;
+    external_data_ = nullptr;
+    external_data_size_ = 0;
+}
+
+void PostingList::AssignExternal(const Block* blocks, size_t block_count, const uint8_t* data, size_t data_size,
+    size_t size, double max_term_freq) {
+    *this = PostingList();
+    if (block_count == 0) {
+        return;
+    }
+    external_blocks_ = blocks;
+    external_block_count_ = block_count;
+    external_data_ = data;
+    external_data_size_ = data_size;
+    compressed_size_ = size;
+    max_term_freq_ = max_term_freq;
+}
+
+size_t PostingList::MemoryUsage() const {
+    return document_ids_.capacity() * sizeof(int) + term_freqs_.capacity() * sizeof(double)
+        + blocks_.capacity() * sizeof(Block) + data_.capacity();
+}
+
+const uint8_t* PostingList::DecodeDocumentIds(size_t block, uint32_t* document_ids) const {
+    const Block* blocks = Blocks();
+    const size_t padded_size = (blocks[block].size + 3) & ~size_t{ 3 };
+    const uint32_t previous = block == 0 ? 0 : static_cast<uint32_t>(blocks[block - 1].last_document_id);
+    return StreamVByteDecodeDelta(CompressedData() + blocks[block].offset, padded_size, previous, document_ids);
+}
+
+PostingCursor::PostingCursor(const PostingList& postings, const int* word_counts)
+    : postings_(&postings)
+    , word_counts_(word_counts) {
+    if (postings.IsCompressed()) {
+        decoded_.resize(2 * POSTING_BLOCK_SIZE);
+        decoded_freqs_.resize(POSTING_BLOCK_SIZE);
+    }
+    LoadBlock(0);
+}
+
+void PostingCursor::SeekTo(int ordinal) {
+    if (AtEnd() || Ordinal() >= ordinal) {
+        return;
+    }
+    if (postings_->IsCompressed()) {
+        const PostingList::Block* blocks = postings_->Blocks();
+        if (blocks[block_].last_document_id < ordinal) {
+            const PostingList::Block* it = lower_bound(blocks + block_ + 1, blocks + postings_->BlockCount(), ordinal,
+                [](const PostingList::Block& block, int value) { return block.last_document_id < value; });
+            LoadBlock(it - blocks);
+            if (AtEnd()) {
+                return;
+            }
+        }
+    }
+    position_ = lower_bound(document_ids_ + position_, document_ids_ + block_size_, ordinal) - document_ids_;
+    if (position_ == block_size_) {
+        LoadBlock(block_ + 1);
+    }
+}
+
+void PostingCursor::LoadBlock(size_t block) {
+    block_ = block;
+    position_ = 0;
+    if (!postings_->IsCompressed()) {
+        // Несжатый список — один блок из всех документов
+        block_size_ = block == 0 ? postings_->document_ids_.size() : 0;
+        document_ids_ = postings_->document_ids_.data();
+        term_freqs_ = postings_->term_freqs_.data();
+        return;
+    }
+    if (block >= postings_->BlockCount()) {
+        block_size_ = 0;
+        return;
+    }
+    block_size_ = postings_->Blocks()[block].size;
+    uint32_t* document_ids = decoded_.data();
+    uint32_t* counts = document_ids + POSTING_BLOCK_SIZE;
+    const uint8_t* in = postings_->DecodeDocumentIds(block, document_ids);
+    StreamVByteDecode(in, (block_size_ + 3) & ~size_t{ 3 }, counts);
+    for (size_t i = 0; i < block_size_; ++i) {
+        decoded_freqs_[i] = counts[i] * (1.0 / word_counts_[document_ids[i]]);
+    }
+    document_ids_ = reinterpret_cast<const int*>(document_ids);
+    term_freqs_ = decoded_freqs_.data();
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "document_bitmap.h"
+
+// Документов в одном сжатом блоке
+constexpr size_t POSTING_BLOCK_SIZE = 128;
+
+// Список документов слова: id документов отсортированы по возрастанию,
+// частоты лежат в параллельном массиве.
+// Список можно сжать: id кодируются разностями в блоках Stream VByte, а вместо частоты
+// хранится число вхождений слова в документ (частота = вхождения / слов в документе)
+class PostingList {
+public:
+    // Разности id блока считаются от последнего id предыдущего блока
+    struct Block {
+        int last_document_id;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // Insert и Erase работают только с несжатым списком
+    void Insert(int document_id, double term_freq);
+
+    // Вливает count пар (документ, частота), отсортированных по возрастанию и отсутствующих в списке, одним слиянием
+    void InsertSorted(const std::pair<int, double>* postings, size_t count);
+
+    // Возвращает false, если документа в списке нет
+    bool Erase(int document_id);
+
+    bool Contains(int document_id) const;
+
+    // Удаляет за один проход все документы из removed, возвращает их число. Только для несжатого списка
+    size_t EraseDocuments(const DocumentBitmap& removed);
+
+    // word_counts — число слов каждого документа, по нему частоты переводятся в вхождения и обратно
+    void Compress(const int* word_counts);
+    void Decompress(const int* word_counts);
+
+    bool IsCompressed() const {
+        return BlockCount() > 0;
+    }
+
+    // Делает список сжатым с данными во внешней памяти (отображённый снимок индекса).
+    // Данные не копируются и должны жить, пока список не изменят или не распакуют
+    void AssignExternal(const Block* blocks, size_t block_count, const uint8_t* data, size_t data_size,
+        size_t size, double max_term_freq);
+
+    // Сжатое представление, только для сжатого списка
+    const Block* Blocks() const {
+        return external_blocks_ != nullptr ? external_blocks_ : blocks_.data();
+    }
+
+    size_t BlockCount() const {
+        return external_blocks_ != nullptr ? external_block_count_ : blocks_.size();
+    }
+
+    const uint8_t* CompressedData() const {
+        return external_blocks_ != nullptr ? external_data_ : data_.data();
+    }
+
+    size_t CompressedDataSize() const {
+        return external_blocks_ != nullptr ? external_data_size_ : data_.size();
+    }
+
+    // Занимаемая списком память в байтах (без внешних данных)
+    size_t MemoryUsage() const;
+
+    // Только для несжатого списка; сжатый читается через PostingCursor
+    const std::vector<int>& DocumentIds() const {
+        return document_ids_;
+    }
+
+    const std::vector<double>& TermFreqs() const {
+        return term_freqs_;
+    }
+
+    // Наибольшая частота слова среди документов списка
+    double MaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    size_t size() const {
+        return IsCompressed() ? compressed_size_ : document_ids_.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+private:
+    friend class PostingCursor;
+
+    std::vector<int> document_ids_;
+    std::vector<double> term_freqs_;
+    double max_term_freq_ = 0.0;
+
+    // Сжатое представление: в data_ для каждого блока идут разности id, затем вхождения
+    std::vector<Block> blocks_;
+    std::vector<uint8_t> data_;
+    size_t compressed_size_ = 0;
+    // Сжатое представление во внешней памяти вместо blocks_ и data_
+    const Block* external_blocks_ = nullptr;
+    size_t external_block_count_ = 0;
+    const uint8_t* external_data_ = nullptr;
+    size_t external_data_size_ = 0;
+
+    // Возвращает указатель на вхождения блока
+    const uint8_t* DecodeDocumentIds(size_t block, uint32_t* document_ids) const;
+};
+
+// Последовательный обход списка в любом представлении; сжатый список декодируется поблочно
+class PostingCursor {
+public:
+    PostingCursor(const PostingList& postings, const int* word_counts);
+
+    PostingCursor(PostingCursor&&) = default;
+    PostingCursor& operator=(PostingCursor&&) = default;
+
+    bool AtEnd() const {
+        return position_ == block_size_;
+    }
+
+    int Ordinal() const {
+        return document_ids_[position_];
+    }
+
+    double TermFreq() const {
+        return term_freqs_[position_];
+    }
+
+    void Next() {
+        if (++position_ == block_size_) {
+            LoadBlock(block_ + 1);
+        }
+    }
+
+    // Переходит к первому документу не меньше ordinal, целые блоки пропускаются без декодирования
+    void SeekTo(int ordinal);
+
+private:
+    const PostingList* postings_;
+    const int* word_counts_;
+    size_t block_ = 0;
+    size_t position_ = 0;
+    size_t block_size_ = 0;
+    const int* document_ids_ = nullptr;
+    const double* term_freqs_ = nullptr;
+    // Буферы декодированного блока
+    std::vector<uint32_t> decoded_;
+    std::vector<double> decoded_freqs_;
+
+    void LoadBlock(size_t block);
+};
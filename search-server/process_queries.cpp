@@ -1,28 +1,70 @@
 #include "process_queries.h"
+#include <numeric>
 using namespace std;
 
-vector<vector<Document>> ProcessQueries(
-    const SearchServer& search_server,
-    const vector<string>& queries) {
+namespace {
+
+template <typename Index>
+vector<vector<Document>> FindTopDocumentsForEach(const Index& index, const vector<string>& queries) {
     vector<vector<Document>> documents_lists(queries.size());
-   /*     for (const string& query : queries) {
-        documents_lists.push_back(search_server.FindTopDocuments(query));
-    }*/
     transform(execution::par, queries.begin(), queries.end(), documents_lists.begin(),
-             [&search_server](const string& query) {return search_server.FindTopDocuments(query);});
+             [&index](const string& query) {return index.FindTopDocuments(query);});
     return documents_lists;
 }
 
-list<Document> ProcessQueriesJoined(
+}
+
+vector<vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const vector<string>& queries) {
-    list<Document> result;
+    return FindTopDocumentsForEach(search_server, queries);
+}
+
+vector<vector<Document>> ProcessQueries(
+    const SegmentedIndex::View& view,
+    const vector<string>& queries) {
+    return FindTopDocumentsForEach(view, queries);
+}
 
-    for (auto& now : ProcessQueries(search_server, queries)) {
-        for (auto& docs : now) {
-            result.push_back(docs);
-        }
+vector<Document> ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const vector<string>& queries) {
+    QueryResultsBuilder builder(queries.size());
+    vector<size_t> query_indexes(queries.size());
+    iota(query_indexes.begin(), query_indexes.end(), size_t{ 0 });
+    for_each(execution::par, query_indexes.begin(), query_indexes.end(), [&](const size_t i) {
+        builder.Add(i, search_server.FindTopDocuments(queries[i]));
+        });
+    return move(builder.Release().documents);
+}
+
+QueryResultsBuilder::QueryResultsBuilder(size_t query_count)
+    : pending_(query_count)
+    , is_pending_(query_count, 0) {
+    results_.offsets.reserve(query_count + 1);
+}
+
+void QueryResultsBuilder::Add(size_t query_index, vector<Document>&& documents) {
+    lock_guard guard(mutex_);
+    if (query_index != results_.size()) {
+        pending_[query_index] = move(documents);
+        is_pending_[query_index] = 1;
+        return;
     }
+    Append(documents);
+    for (size_t next = results_.size(); next < is_pending_.size() && is_pending_[next]; ++next) {
+        Append(pending_[next]);
+        vector<Document>().swap(pending_[next]);
+        is_pending_[next] = 0;
+    }
+}
 
-    return result;
-}
\ No newline at end of file
+QueryResults QueryResultsBuilder::Release() {
+    lock_guard guard(mutex_);
+    return move(results_);
+}
+
+void QueryResultsBuilder::Append(vector<Document>& documents) {
+    results_.documents.insert(results_.documents.end(), documents.begin(), documents.end());
+    results_.offsets.push_back(results_.documents.size());
+}
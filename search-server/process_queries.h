@@ -1,17 +1,81 @@
 #pragma once
 #include "search_server.h"
 #include <vector>
-#include <list>
 #include <algorithm>
 #include <execution>
+#include <mutex>
 #include "document.h"
+#include "paginator.h"
+#include "query_executor.h"
+#include "segmented_index.h"
+
+// Результаты пакета запросов в одном непрерывном буфере:
+// документы запроса i лежат в documents[offsets[i], offsets[i + 1])
+struct QueryResults {
+    std::vector<Document> documents;
+    std::vector<size_t> offsets{ 0 };
+
+    // Число запросов
+    size_t size() const {
+        return offsets.size() - 1;
+    }
+
+    IteratorRange<std::vector<Document>::const_iterator> operator[](size_t query_index) const {
+        return { documents.begin() + offsets[query_index], documents.begin() + offsets[query_index + 1] };
+    }
+};
+
+// Собирает QueryResults из результатов, готовых в любом порядке: результат дописывается в общий буфер,
+// как только дописаны все запросы до него, а до тех пор ждёт в своём векторе. Add потокобезопасен
+class QueryResultsBuilder {
+public:
+    explicit QueryResultsBuilder(size_t query_count);
+
+    void Add(size_t query_index, std::vector<Document>&& documents);
+    // Вызывать после Add для каждого запроса
+    QueryResults Release();
+
+private:
+    std::mutex mutex_;
+    QueryResults results_;
+    // Готовые результаты запросов после ещё не готового
+    std::vector<std::vector<Document>> pending_;
+    std::vector<char> is_pending_;
+
+    void Append(std::vector<Document>& documents);
+};
 
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
+// Запросы к опубликованному представлению SegmentedIndex; индекс можно менять параллельно
+std::vector<std::vector<Document>> ProcessQueries(
+    const SegmentedIndex::View& view,
+    const std::vector<std::string>& queries);
+
+// Запросы в пуле executor; index — SearchServer или SegmentedIndex::View
+template <typename Index>
+QueryResults ProcessQueries(
+    QueryExecutor& executor,
+    const Index& index,
+    const std::vector<std::string>& queries,
+    size_t top_k = MAX_RESULT_DOCUMENT_COUNT);
 
-std::list<Document> ProcessQueriesJoined(
+
+// Документы всех запросов подряд
+std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries);
+
+template <typename Index>
+QueryResults ProcessQueries(QueryExecutor& executor, const Index& index, const std::vector<std::string>& queries,
+    size_t top_k) {
+    // Заранее под каждый запрос top_k мест не выделяется: буфер растёт по мере готовности запросов
+    QueryResultsBuilder builder(queries.size());
+    executor.ForEachResult(index, queries, [&builder](size_t query_index, std::vector<Document>&& query_documents) {
+        builder.Add(query_index, std::move(query_documents));
+        }, top_k);
+    return builder.Release();
+}
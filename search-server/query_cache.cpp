@@ -0,0 +1,94 @@
+#include "query_cache.h"
+using namespace std;
+
+size_t QueryCache::KeyHash::operator()(const Key& key) const {
+    uint64_t hash = (static_cast<uint64_t>(key.status) * 31 + static_cast<uint64_t>(key.policy)) * 31 + key.top_k;
+    const auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 29;
+    };
+    for (const TermId term_id : key.plus_words) {
+        mix(term_id);
+    }
+    // Разделитель, чтобы плюс- и минус-слова не смешивались
+    mix(INVALID_TERM_ID);
+    for (const TermId term_id : key.minus_words) {
+        mix(term_id);
+    }
+    return static_cast<size_t>(hash);
+}
+
+QueryCache::QueryCache(size_t capacity)
+    : capacity_(capacity)
+    , shards_(QUERY_CACHE_SHARD_COUNT) {
+}
+
+bool QueryCache::Find(const Key& key, uint64_t generation, vector<Document>& documents) {
+    if (!IsEnabled()) {
+        return false;
+    }
+    const size_t hash = KeyHash{}(key);
+    Shard& shard = ShardOf(hash);
+    lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        ++shard.misses;
+        return false;
+    }
+    if (it->second->generation != generation) {
+        shard.entries.erase(it->second);
+        shard.index.erase(it);
+        ++shard.misses;
+        return false;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    documents = it->second->documents;
+    ++shard.hits;
+    return true;
+}
+
+void QueryCache::Insert(Key key, uint64_t generation, vector<Document> documents) {
+    if (!IsEnabled()) {
+        return;
+    }
+    const size_t hash = KeyHash{}(key);
+    Shard& shard = ShardOf(hash);
+    lock_guard guard(shard.mutex);
+    const auto [it, inserted] = shard.index.emplace(move(key), shard.entries.end());
+    if (!inserted) {
+        // Тот же запрос успел посчитать другой поток
+        it->second->generation = generation;
+        it->second->documents = move(documents);
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    shard.entries.push_front({ &it->first, generation, move(documents) });
+    it->second = shard.entries.begin();
+    if (shard.entries.size() > ShardCapacity()) {
+        // Ключ принадлежит удаляемому узлу, поэтому удаляем по итератору
+        shard.index.erase(shard.index.find(*shard.entries.back().key));
+        shard.entries.pop_back();
+        ++shard.evictions;
+    }
+}
+
+void QueryCache::SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    for (Shard& shard : shards_) {
+        lock_guard guard(shard.mutex);
+        shard.entries.clear();
+        shard.index.clear();
+    }
+}
+
+QueryCache::Stats QueryCache::GetStats() const {
+    Stats stats;
+    for (const Shard& shard : shards_) {
+        lock_guard guard(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.size += shard.entries.size();
+    }
+    return stats;
+}
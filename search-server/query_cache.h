@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "concurrent_map.h"
+#include "document.h"
+#include "term_dictionary.h"
+
+constexpr size_t QUERY_CACHE_DEFAULT_CAPACITY = 4096;
+constexpr size_t QUERY_CACHE_SHARD_COUNT = 16;
+
+// Кеш результатов поиска с вытеснением давно не использованных (LRU), разбитый на шарды.
+// Каждый результат помечен поколением индекса, при котором он посчитан:
+// после изменения индекса старые результаты считаются промахами
+class QueryCache {
+public:
+    // Способ поиска: полный перебор и поиск с отсечением считают результаты по-разному
+    enum class Policy {
+        SEQUENCED,
+        PARALLEL,
+        MAX_SCORE,
+    };
+
+    // Запрос после разбора: отсортированные номера слов без повторов
+    struct Key {
+        std::vector<TermId> plus_words;
+        std::vector<TermId> minus_words;
+        DocumentStatus status;
+        size_t top_k;
+        Policy policy = Policy::SEQUENCED;
+
+        bool operator==(const Key& other) const {
+            return status == other.status && top_k == other.top_k && policy == other.policy
+                && plus_words == other.plus_words && minus_words == other.minus_words;
+        }
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t size = 0;
+    };
+
+    // capacity — наибольшее число результатов в кеше, 0 выключает кеш
+    explicit QueryCache(size_t capacity);
+
+    bool IsEnabled() const {
+        return capacity_ > 0;
+    }
+
+    // Возвращает false, если результата нет или он посчитан для другого поколения
+    bool Find(const Key& key, uint64_t generation, std::vector<Document>& documents);
+    void Insert(Key key, uint64_t generation, std::vector<Document> documents);
+
+    // Очищает кеш; не должен вызываться одновременно с поиском
+    void SetCapacity(size_t capacity);
+
+    Stats GetStats() const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry;
+    using Index = std::unordered_map<Key, std::list<Entry>::iterator, KeyHash>;
+
+    struct Entry {
+        // Ключ хранится в узле индекса: адрес узла не меняется при перехешировании,
+        // в отличие от итераторов
+        const Key* key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        mutable std::mutex mutex;
+        // В начале — последние использованные
+        std::list<Entry> entries;
+        Index index;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    size_t capacity_;
+    std::vector<Shard> shards_;
+
+    Shard& ShardOf(size_t hash) {
+        return shards_[(hash >> 16) % shards_.size()];
+    }
+
+    size_t ShardCapacity() const {
+        return (capacity_ + shards_.size() - 1) / shards_.size();
+    }
+};
@@ -0,0 +1,99 @@
+#include "query_executor.h"
+using namespace std;
+
+namespace {
+
+// Номер потока пула, в котором идёт выполнение, и его пул
+thread_local const QueryExecutor* current_executor = nullptr;
+thread_local size_t current_worker = 0;
+
+}  // namespace
+
+QueryExecutor::QueryExecutor(size_t worker_count, size_t queue_depth)
+    : queue_depth_(max<size_t>(queue_depth, 1))
+    , workers_(max<size_t>(worker_count, 1)) {
+    threads_.reserve(workers_.size());
+    for (size_t worker = 0; worker < workers_.size(); ++worker) {
+        threads_.emplace_back(&QueryExecutor::Run, this, worker);
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    has_tasks_.notify_all();
+    for (thread& worker_thread : threads_) {
+        worker_thread.join();
+    }
+}
+
+void QueryExecutor::Push(Task task) {
+    size_t worker;
+    if (current_executor == this) {
+        worker = current_worker;
+        lock_guard guard(mutex_);
+        ++queued_;
+    }
+    else {
+        worker = next_worker_.fetch_add(1) % workers_.size();
+        unique_lock lock(mutex_);
+        has_space_.wait(lock, [this] { return queued_ < queue_depth_; });
+        ++queued_;
+    }
+    {
+        lock_guard guard(workers_[worker].mutex);
+        workers_[worker].tasks.push_back(move(task));
+    }
+    has_tasks_.notify_one();
+}
+
+bool QueryExecutor::TryPop(size_t worker, Task& task) {
+    {
+        Worker& own = workers_[worker];
+        lock_guard guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        Worker& victim = workers_[(worker + i) % workers_.size()];
+        lock_guard guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            ++stolen_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void QueryExecutor::Run(size_t worker) {
+    current_executor = this;
+    current_worker = worker;
+    Task task;
+    while (true) {
+        if (TryPop(worker, task)) {
+            {
+                lock_guard guard(mutex_);
+                --queued_;
+            }
+            has_space_.notify_one();
+            ++executed_;
+            task();
+            task = nullptr;
+            continue;
+        }
+        unique_lock lock(mutex_);
+        // queued_ увеличивается раньше, чем задача попадает в очередь, поэтому поток
+        // может проснуться чуть раньше времени и сделать лишний круг
+        has_tasks_.wait(lock, [this] { return queued_ > 0 || stopping_; });
+        if (stopping_ && queued_ == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "concurrent_map.h"
+#include "document.h"
+#include "search_server.h"
+
+// Сколько задач может ждать в очередях исполнителя по умолчанию
+constexpr size_t QUERY_EXECUTOR_DEFAULT_QUEUE_DEPTH = 1024;
+
+// Пул потоков для выполнения запросов с перехватом работы: у каждого потока своя очередь,
+// он берёт задачи с её конца, а освободившись, забирает задачи из начала чужих очередей.
+// Число ждущих задач ограничено: Submit из постороннего потока ждёт, пока освободится место.
+// Задачи, поставленные из потоков пула, кладутся в очередь своего потока без ожидания, чтобы пул не встал
+class QueryExecutor {
+public:
+    struct Stats {
+        // Взято на выполнение задач
+        size_t executed = 0;
+        // Из них взято из чужой очереди
+        size_t stolen = 0;
+    };
+
+    explicit QueryExecutor(size_t worker_count = std::max(1u, std::thread::hardware_concurrency()),
+        size_t queue_depth = QUERY_EXECUTOR_DEFAULT_QUEUE_DEPTH);
+    // Выполняет уже поставленные задачи и останавливает потоки
+    ~QueryExecutor();
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    size_t GetWorkerCount() const {
+        return threads_.size();
+    }
+
+    Stats GetStats() const {
+        return { executed_.load(), stolen_.load() };
+    }
+
+    // Выполняет function в пуле; исключение из function попадает в future
+    template <typename Function>
+    std::future<std::invoke_result_t<Function>> Submit(Function function);
+
+    // Будущий результат на каждый запрос: не больше top_k лучших документов
+    template <typename Index>
+    std::vector<std::future<std::vector<Document>>> SubmitQueries(const Index& index, const std::vector<std::string>& queries,
+        size_t top_k = MAX_RESULT_DOCUMENT_COUNT);
+
+    // Выполняет запросы и по мере готовности вызывает callback(номер запроса, std::vector<Document>&& результат)
+    // из потоков пула, поэтому callback должен быть потокобезопасным. Возвращает, когда выполнены все запросы;
+    // если какие-то запросы бросили исключение, затем бросает первое из них. Не вызывать из потоков пула
+    template <typename Index, typename Callback>
+    void ForEachResult(const Index& index, const std::vector<std::string>& queries, Callback callback,
+        size_t top_k = MAX_RESULT_DOCUMENT_COUNT);
+
+private:
+    using Task = std::function<void()>;
+
+    struct alignas(CACHE_LINE_SIZE) Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    const size_t queue_depth_;
+    std::vector<Worker> workers_;
+    std::vector<std::thread> threads_;
+
+    // Защищает queued_ и stopping_; на нём спят свободные потоки и ждущие места отправители
+    std::mutex mutex_;
+    std::condition_variable has_tasks_;
+    std::condition_variable has_space_;
+    size_t queued_ = 0;
+    bool stopping_ = false;
+
+    std::atomic<size_t> next_worker_ = 0;
+    std::atomic<size_t> executed_ = 0;
+    std::atomic<size_t> stolen_ = 0;
+
+    void Push(Task task);
+    // Берёт задачу из своей очереди, иначе из чужой
+    bool TryPop(size_t worker, Task& task);
+    void Run(size_t worker);
+};
+
+template <typename Function>
+std::future<std::invoke_result_t<Function>> QueryExecutor::Submit(Function function) {
+    // std::function требует копируемости, а packaged_task только перемещается
+    auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Function>()>>(std::move(function));
+    auto result = task->get_future();
+    Push([task] {
+        (*task)();
+        });
+    return result;
+}
+
+template <typename Index>
+std::vector<std::future<std::vector<Document>>> QueryExecutor::SubmitQueries(const Index& index,
+    const std::vector<std::string>& queries, size_t top_k) {
+    std::vector<std::future<std::vector<Document>>> results;
+    results.reserve(queries.size());
+    for (const std::string& query : queries) {
+        results.push_back(Submit([&index, &query, top_k] {
+            return index.FindTopDocuments(query, DocumentStatus::ACTUAL, top_k);
+            }));
+    }
+    return results;
+}
+
+template <typename Index, typename Callback>
+void QueryExecutor::ForEachResult(const Index& index, const std::vector<std::string>& queries, Callback callback,
+    size_t top_k) {
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t remaining = queries.size();
+    std::exception_ptr error;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        Push([&, i] {
+            std::exception_ptr query_error;
+            try {
+                callback(i, index.FindTopDocuments(queries[i], DocumentStatus::ACTUAL, top_k));
+            }
+            catch (...) {
+                query_error = std::current_exception();
+            }
+            std::lock_guard guard(mutex);
+            if (query_error && !error) {
+                error = query_error;
+            }
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+            });
+    }
+    std::unique_lock lock(mutex);
+    done.wait(lock, [&remaining] { return remaining == 0; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
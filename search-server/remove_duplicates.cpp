@@ -1,20 +1,158 @@
 #include "remove_duplicates.h"
+#include <algorithm>
+#include <execution>
+#include <map>
+#include <unordered_map>
 using namespace std;
 
-void RemoveDuplicates(SearchServer& search_server) {
-    vector<int> remove_id_list;
-    set<string> document_words_set;
-    for (auto iter = search_server.begin(); iter != search_server.end(); ++iter) {
-        string words;
-        for (auto now : search_server.GetWordFrequencies(*iter)) {
-            words += now.first;
+namespace {
+
+// Слова упорядочены по возрастанию; у двух пустых множеств сходство 1
+double ComputeJaccardSimilarity(const vector<string_view>& lhs, const map<string_view, double>& rhs) {
+    size_t common = 0;
+    auto rhs_it = rhs.begin();
+    for (const string_view word : lhs) {
+        while (rhs_it != rhs.end() && rhs_it->first < word) {
+            ++rhs_it;
         }
-        if (!document_words_set.insert(words).second) {
-            remove_id_list.push_back(*iter);
+        if (rhs_it != rhs.end() && rhs_it->first == word) {
+            ++common;
+            ++rhs_it;
         }
     }
-    for (int i : remove_id_list) {
-        cout << "Found duplicate document id " << i << endl;
-        search_server.RemoveDocument(i);
+    const size_t united = lhs.size() + rhs.size() - common;
+    return united == 0 ? 1.0 : static_cast<double>(common) / united;
+}
+
+vector<string_view> GetDocumentWords(const SearchServer& search_server, int document_id) {
+    const map<string_view, double>& word_freqs = search_server.GetWordFrequencies(document_id);
+    vector<string_view> words;
+    words.reserve(word_freqs.size());
+    for (const auto& [word, freq] : word_freqs) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+// Первый кандидат, сходство с которым не ниже порога
+optional<int> FindSimilarDocument(const SearchServer& search_server, const MinHashIndex& index,
+    const vector<string_view>& words, const MinHashIndex::Signature& signature, double jaccard_threshold) {
+    for (const int candidate : index.FindCandidates(signature)) {
+        if (ComputeJaccardSimilarity(words, search_server.GetWordFrequencies(candidate)) >= jaccard_threshold) {
+            return candidate;
+        }
+    }
+    return nullopt;
+}
+
+vector<MinHashIndex::Signature> ComputeSignatures(const SearchServer& search_server, const MinHashIndex& index,
+    const vector<int>& document_ids) {
+    vector<MinHashIndex::Signature> signatures(document_ids.size());
+    transform(execution::par, document_ids.begin(), document_ids.end(), signatures.begin(),
+        [&search_server, &index](const int document_id) {
+            return index.ComputeSignature(GetDocumentWords(search_server, document_id));
+        });
+    return signatures;
+}
+
+bool HaveSameWords(const map<string_view, double>& lhs, const map<string_view, double>& rhs) {
+    return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+        [](const auto& lhs_word, const auto& rhs_word) { return lhs_word.first == rhs_word.first; });
+}
+
+struct DocumentFingerprintHasher {
+    size_t operator()(const DocumentFingerprint& fingerprint) const {
+        // Половины отпечатка уже перемешаны
+        return static_cast<size_t>(fingerprint.low);
     }
-}
\ No newline at end of file
+};
+
+}  // namespace
+
+vector<int> FindDuplicates(const SearchServer& search_server) {
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    vector<DocumentFingerprint> fingerprints(document_ids.size());
+    transform(execution::par, document_ids.begin(), document_ids.end(), fingerprints.begin(),
+        [&search_server](const int document_id) {
+            return search_server.GetDocumentFingerprint(document_id);
+        });
+
+    // Документы перебираются по возрастанию id, поэтому остаётся первый из одинаковых.
+    // Отпечатки разных множеств слов могут совпасть, поэтому совпадение проверяется по самим словам
+    unordered_multimap<DocumentFingerprint, int, DocumentFingerprintHasher> originals;
+    originals.reserve(document_ids.size());
+    vector<int> duplicates;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        const auto [begin, end] = originals.equal_range(fingerprints[i]);
+        const int document_id = document_ids[i];
+        if (any_of(begin, end, [&search_server, document_id](const auto& original) {
+            return HaveSameWords(search_server.GetWordFrequencies(original.second), search_server.GetWordFrequencies(document_id));
+            })) {
+            duplicates.push_back(document_id);
+        }
+        else {
+            originals.emplace(fingerprints[i], document_id);
+        }
+    }
+    return duplicates;
+}
+
+vector<int> RemoveDuplicates(SearchServer& search_server) {
+    vector<int> duplicates = FindDuplicates(search_server);
+    search_server.RemoveDocuments(duplicates);
+    return duplicates;
+}
+
+vector<int> FindNearDuplicates(const SearchServer& search_server, double jaccard_threshold) {
+    MinHashIndex index(jaccard_threshold);
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    const vector<MinHashIndex::Signature> signatures = ComputeSignatures(search_server, index, document_ids);
+
+    // В индексе только оставленные документы, поэтому цепочки похожих документов не удаляются целиком
+    vector<int> duplicates;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        if (FindSimilarDocument(search_server, index, GetDocumentWords(search_server, document_ids[i]), signatures[i],
+            jaccard_threshold)) {
+            duplicates.push_back(document_ids[i]);
+        }
+        else {
+            index.Add(document_ids[i], signatures[i]);
+        }
+    }
+    return duplicates;
+}
+
+vector<int> RemoveNearDuplicates(SearchServer& search_server, double jaccard_threshold) {
+    vector<int> duplicates = FindNearDuplicates(search_server, jaccard_threshold);
+    search_server.RemoveDocuments(duplicates);
+    return duplicates;
+}
+
+NearDuplicateFilter::NearDuplicateFilter(SearchServer& search_server, double jaccard_threshold)
+    : search_server_(search_server)
+    , jaccard_threshold_(jaccard_threshold)
+    , index_(jaccard_threshold)
+{
+    const vector<int> document_ids(search_server_.begin(), search_server_.end());
+    const vector<MinHashIndex::Signature> signatures = ComputeSignatures(search_server_, index_, document_ids);
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        index_.Add(document_ids[i], signatures[i]);
+    }
+}
+
+optional<int> NearDuplicateFilter::AddDocument(int document_id, string_view document, DocumentStatus status,
+    const vector<int>& ratings) {
+    const vector<string_view> words = search_server_.GetIndexedWords(document);
+    const MinHashIndex::Signature signature = index_.ComputeSignature(words);
+    if (const optional<int> similar = FindSimilarDocument(search_server_, index_, words, signature, jaccard_threshold_)) {
+        return similar;
+    }
+    search_server_.AddDocument(document_id, document, status, ratings);
+    index_.Add(document_id, signature);
+    return nullopt;
+}
+
+void NearDuplicateFilter::RemoveDocument(int document_id) {
+    search_server_.RemoveDocument(document_id);
+    index_.Remove(document_id);
+}
@@ -1,5 +1,47 @@
 #pragma once
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "minhash_index.h"
 #include "search_server.h"
 
+// Сходство Жаккара множеств слов, начиная с которого документ считается почти дубликатом
+constexpr double NEAR_DUPLICATE_DEFAULT_THRESHOLD = 0.8;
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+// id документов, множество слов которых совпадает с множеством слов документа с меньшим id, по возрастанию.
+// Документы сравниваются по 128-битным отпечаткам (GetDocumentFingerprint), которые считаются параллельно;
+// совпадение отпечатков подтверждается сравнением слов из GetWordFrequencies
+std::vector<int> FindDuplicates(const SearchServer& search_server);
+
+// Удаляет дубликаты одним вызовом RemoveDocuments и возвращает их id
+std::vector<int> RemoveDuplicates(SearchServer& search_server);
+
+// id почти дубликатов по возрастанию: документов, сходство Жаккара множества слов которых с одним из
+// оставленных документов с меньшим id не ниже порога. Сигнатуры MinHash считаются параллельно,
+// кандидаты ищутся по LSH-бандам и проверяются точным сходством по GetWordFrequencies
+std::vector<int> FindNearDuplicates(const SearchServer& search_server,
+    double jaccard_threshold = NEAR_DUPLICATE_DEFAULT_THRESHOLD);
+
+// Удаляет почти дубликаты одним вызовом RemoveDocuments и возвращает их id
+std::vector<int> RemoveNearDuplicates(SearchServer& search_server,
+    double jaccard_threshold = NEAR_DUPLICATE_DEFAULT_THRESHOLD);
+
+// Отсев почти дубликатов при загрузке: документ попадает в сервер, только если в нём нет документа
+// со сходством не ниже порога. Документы, которые были в сервере при создании фильтра, учитываются;
+// документы, добавленные или удалённые мимо фильтра, — нет
+class NearDuplicateFilter {
+public:
+    explicit NearDuplicateFilter(SearchServer& search_server,
+        double jaccard_threshold = NEAR_DUPLICATE_DEFAULT_THRESHOLD);
+
+    // Добавляет документ и возвращает пустой результат либо возвращает id похожего документа.
+    // Почти дубликат отбрасывается до остальных проверок AddDocument; ошибки — как у SearchServer::AddDocument
+    std::optional<int> AddDocument(int document_id, std::string_view document, DocumentStatus status,
+        const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+private:
+    SearchServer& search_server_;
+    double jaccard_threshold_;
+    MinHashIndex index_;
+};
@@ -1,36 +1,150 @@
 #include "request_queue.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
 using namespace std;
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
-    : search_server_(search_server), cur_time(0), empty_results(0) {
+size_t LatencyHistogram::GetBucket(uint64_t nanoseconds) {
+    if (nanoseconds < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(nanoseconds);
+    }
+    int exponent = 0;
+    while ((nanoseconds >> exponent) >= 2 * SUB_BUCKET_COUNT) {
+        ++exponent;
+    }
+    // Старший бит и следующие SUB_BUCKET_BITS битов значения
+    return SUB_BUCKET_COUNT + exponent * SUB_BUCKET_COUNT + static_cast<size_t>((nanoseconds >> exponent) - SUB_BUCKET_COUNT);
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t bucket) {
+    if (bucket < SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+    const size_t exponent = bucket / SUB_BUCKET_COUNT - 1;
+    const uint64_t lower_bound = static_cast<uint64_t>(SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT) << exponent;
+    return lower_bound + ((uint64_t{ 1 } << exponent) - 1);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        counts_[bucket] += other.counts_[bucket];
+    }
+    total_count_ += other.total_count_;
+}
+
+chrono::nanoseconds LatencyHistogram::GetPercentile(double quantile) const {
+    if (total_count_ == 0) {
+        return chrono::nanoseconds(0);
+    }
+    // Номер (с единицы) значения, на которое приходится перцентиль
+    const uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(quantile * total_count_ + 0.5));
+    uint64_t count = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        count += counts_[bucket];
+        if (count >= rank) {
+            return chrono::nanoseconds(GetBucketUpperBound(bucket));
+        }
+    }
+    return chrono::nanoseconds(GetBucketUpperBound(BUCKET_COUNT - 1));
+}
+
+RequestQueue::RequestQueue(const SearchServer& search_server, size_t window_size)
+    : search_server_(search_server)
+    , slots_(window_size)
+{
+    if (window_size == 0) {
+        throw invalid_argument("Window size must be positive"s);
+    }
 }
 
-// сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
-    query_result_.docs = FindDoc(search_server_.FindTopDocuments(raw_query, status));
-    requests_.push_back(query_result_);
-    return query_result_.docs;
+    const Clock::time_point start = Clock::now();
+    vector<Document> documents = search_server_.FindTopDocuments(raw_query, status);
+    FinishRequest(start, documents.size());
+    return documents;
 }
+
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
-    query_result_.docs = FindDoc(search_server_.FindTopDocuments(raw_query));
-    requests_.push_back(query_result_);
-    return query_result_.docs;
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
+
+void RequestQueue::AddRequest(size_t hit_count, chrono::nanoseconds latency) {
+    WriteRequest(GetTimestamp(Clock::now()), hit_count, static_cast<uint64_t>(max<int64_t>(0, latency.count())));
+}
+
+int64_t RequestQueue::GetTimestamp(Clock::time_point time) {
+    return chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+void RequestQueue::FinishRequest(Clock::time_point start, size_t hit_count) {
+    const Clock::time_point finish = Clock::now();
+    WriteRequest(GetTimestamp(finish), hit_count,
+        static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(finish - start).count()));
+}
+
+void RequestQueue::WriteRequest(int64_t timestamp, size_t hit_count, uint64_t latency) {
+    const uint64_t request = next_request_.fetch_add(1, memory_order_relaxed);
+    Slot& slot = slots_[request % slots_.size()];
+    // Ячейка освобождается, когда дописан запрос, который был в ней окно назад
+    const uint64_t previous_sequence = request < slots_.size() ? 0 : request - slots_.size() + 1;
+    while (slot.sequence.load(memory_order_acquire) != previous_sequence) {
+        this_thread::yield();
+    }
+    // Пока запись не закончена, ячейка помечена пустой: GetStats не возьмёт из неё время
+    slot.sequence.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    if (previous_sequence != 0) {
+        // Вытесняемый запрос уходит из счётчиков окна
+        if (slot.hit_count.load(memory_order_relaxed) == 0) {
+            no_result_count_.fetch_sub(1, memory_order_relaxed);
+        }
+        latency_counts_[LatencyHistogram::GetBucket(slot.latency.load(memory_order_relaxed))].fetch_sub(1, memory_order_relaxed);
+    }
+    slot.timestamp.store(timestamp, memory_order_relaxed);
+    slot.latency.store(latency, memory_order_relaxed);
+    slot.hit_count.store(static_cast<uint32_t>(min<size_t>(hit_count, UINT32_MAX)), memory_order_relaxed);
+    if (hit_count == 0) {
+        no_result_count_.fetch_add(1, memory_order_relaxed);
+    }
+    latency_counts_[LatencyHistogram::GetBucket(latency)].fetch_add(1, memory_order_relaxed);
+    slot.sequence.store(request + 1, memory_order_release);
+}
+
 int RequestQueue::GetNoResultRequests() const {
-    return empty_results;
+    return static_cast<int>(no_result_count_.load(memory_order_relaxed));
 }
 
-vector<Document> RequestQueue::FindDoc(vector<Document> find_docs) {
-    bool empty_result = find_docs.empty();
-    ++cur_time;
-    if (cur_time > min_in_day_) {
-        if (requests_.front().docs.empty()) {
-            --empty_results;
+RequestQueue::Stats RequestQueue::GetStats() const {
+    Stats stats;
+    const uint64_t request_count = next_request_.load(memory_order_relaxed);
+    stats.request_count = static_cast<size_t>(min<uint64_t>(request_count, slots_.size()));
+    stats.no_result_count = no_result_count_.load(memory_order_relaxed);
+    for (size_t bucket = 0; bucket < LatencyHistogram::BUCKET_COUNT; ++bucket) {
+        if (const uint64_t count = latency_counts_[bucket].load(memory_order_relaxed)) {
+            stats.latency.Add(LatencyHistogram::GetBucketUpperBound(bucket), count);
         }
-        requests_.pop_front();
     }
-    if (empty_result) {
-        ++empty_results;
+    if (stats.request_count == 0) {
+        return stats;
+    }
+    stats.no_result_rate = static_cast<double>(stats.no_result_count) / stats.request_count;
+    // Самый старый запрос окна мог ещё не дописаться, а его ячейку — уже занять следующий запрос,
+    // поэтому время берётся у самого старого записанного запроса окна
+    for (uint64_t request = request_count - stats.request_count; request < request_count; ++request) {
+        const Slot& slot = slots_[request % slots_.size()];
+        if (slot.sequence.load(memory_order_acquire) != request + 1) {
+            continue;
+        }
+        const int64_t timestamp = slot.timestamp.load(memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (slot.sequence.load(memory_order_relaxed) != request + 1) {
+            continue;
+        }
+        const int64_t elapsed = GetTimestamp(Clock::now()) - timestamp;
+        if (elapsed > 0) {
+            stats.queries_per_second = (request_count - request) * 1e9 / elapsed;
+        }
+        break;
     }
-    return find_docs;
+    return stats;
 }
@@ -1,34 +1,114 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "concurrent_map.h"
 #include "search_server.h"
-#include <deque>
 
-class RequestQueue {
+// Окно статистики по умолчанию — последние 1440 запросов (по запросу в минуту за сутки)
+constexpr size_t REQUEST_QUEUE_DEFAULT_WINDOW = 1440;
+
+// Гистограмма задержек с логарифмическими корзинами: по 8 корзин на каждую степень двойки наносекунд,
+// погрешность перцентиля не больше 1/8 значения. Гистограммы складываются (Merge)
+class LatencyHistogram {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr size_t SUB_BUCKET_COUNT = size_t{ 1 } << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKET_COUNT + (64 - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT;
 
-    // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
-    template <typename DocumentPredicate>
-    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-        query_result_.docs = FindDoc(search_server_.FindTopDocuments(raw_query, document_predicate));
-        requests_.push_back(query_result_);
-        return query_result_.docs;
+    static size_t GetBucket(uint64_t nanoseconds);
+    // Наибольшая задержка, попадающая в корзину
+    static uint64_t GetBucketUpperBound(size_t bucket);
+
+    void Add(uint64_t nanoseconds, uint64_t count = 1) {
+        counts_[GetBucket(nanoseconds)] += count;
+        total_count_ += count;
+    }
+
+    void Merge(const LatencyHistogram& other);
 
+    uint64_t GetCount() const {
+        return total_count_;
     }
+
+    uint64_t GetBucketCount(size_t bucket) const {
+        return counts_[bucket];
+    }
+
+    // Верхняя граница корзины, в которую попадает перцентиль (quantile из [0, 1]); 0 для пустой гистограммы
+    std::chrono::nanoseconds GetPercentile(double quantile) const;
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> counts_{};
+    uint64_t total_count_ = 0;
+};
+
+// Статистика запросов к серверу за скользящее окно из последних window_size запросов.
+// Запросы хранятся компактными записями (время, число найденных документов, задержка) в кольцевом буфере
+// фиксированного размера; счётчики пустых выдач и гистограмма задержек обновляются при записи,
+// поэтому статистика читается без обхода окна. Запись не берёт блокировок и не выделяет памяти,
+// AddFindRequest можно вызывать из многих потоков. Поток ждёт, только если его ячейку ещё дописывает
+// поток, отставший на целое окно
+class RequestQueue {
+public:
+    struct Stats {
+        // Запросов в окне
+        size_t request_count = 0;
+        size_t no_result_count = 0;
+        double no_result_rate = 0.0;
+        // Запросов в секунду от самого старого запроса окна до текущего момента
+        double queries_per_second = 0.0;
+        LatencyHistogram latency;
+    };
+
+    explicit RequestQueue(const SearchServer& search_server, size_t window_size = REQUEST_QUEUE_DEFAULT_WINDOW);
+
+    RequestQueue(const RequestQueue&) = delete;
+    RequestQueue& operator=(const RequestQueue&) = delete;
+
+    // Обёртки методов поиска, которые учитывают запрос в статистике
+    template <typename DocumentPredicate>
+    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
     std::vector<Document> AddFindRequest(const std::string& raw_query);
+
+    // Учитывает запрос, выполненный мимо очереди, например через ProcessQueries
+    void AddRequest(size_t hit_count, std::chrono::nanoseconds latency);
+
     int GetNoResultRequests() const;
+    Stats GetStats() const;
 
 private:
-    struct QueryResult {
-        std::vector<Document> docs;
+    using Clock = std::chrono::steady_clock;
+
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        // Номер записанного запроса + 1; 0 — ячейка ещё пуста или в неё идёт запись
+        std::atomic<uint64_t> sequence{ 0 };
+        std::atomic<int64_t> timestamp{ 0 };
+        std::atomic<uint64_t> latency{ 0 };
+        std::atomic<uint32_t> hit_count{ 0 };
     };
-    QueryResult query_result_;
-    std::deque<QueryResult> requests_;
-    const static int min_in_day_ = 1440;
-    // возможно, здесь вам понадобится что-то ещё
+
     const SearchServer& search_server_;
-    uint64_t  cur_time;
-    int empty_results;
+    std::vector<Slot> slots_;
+    // Следующий номер запроса
+    std::atomic<uint64_t> next_request_{ 0 };
+    std::atomic<size_t> no_result_count_{ 0 };
+    std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT> latency_counts_{};
+
+    static int64_t GetTimestamp(Clock::time_point time);
+    // Записывает запрос, начатый в start и законченный сейчас
+    void FinishRequest(Clock::time_point start, size_t hit_count);
+    void WriteRequest(int64_t timestamp, size_t hit_count, uint64_t latency);
+};
 
-    std::vector<Document> FindDoc(std::vector<Document> find_docs);
-};
\ No newline at end of file
+template <typename DocumentPredicate>
+std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+    const Clock::time_point start = Clock::now();
+    std::vector<Document> documents = search_server_.FindTopDocuments(raw_query, document_predicate);
+    FinishRequest(start, documents.size());
+    return documents;
+}
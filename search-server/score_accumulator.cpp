@@ -0,0 +1,29 @@
+#include "score_accumulator.h"
+#include <algorithm>
+using namespace std;
+
+ScoreAccumulator::ScoreAccumulator(size_t size) {
+    thread_local Buffers thread_buffers;
+    buffers_ = thread_buffers.in_use ? &own_buffers_ : &thread_buffers;
+    buffers_->in_use = true;
+    if (buffers_->states.size() < size) {
+        buffers_->relevance.resize(size, 0.0);
+        buffers_->states.resize(size, State::UNSEEN);
+    }
+}
+
+ScoreAccumulator::~ScoreAccumulator() {
+    for (const size_t index : buffers_->seen) {
+        buffers_->relevance[index] = 0.0;
+        buffers_->states[index] = State::UNSEEN;
+    }
+    buffers_->seen.clear();
+    buffers_->in_use = false;
+}
+
+void ScoreAccumulator::SortSeen() {
+    // Запрос из одного слова встречает документы уже по порядку
+    if (!is_sorted(buffers_->seen.begin(), buffers_->seen.end())) {
+        sort(buffers_->seen.begin(), buffers_->seen.end());
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Плотные накопители релевантности для документов с номерами [0, size): вклад и решение
+// предиката по каждому документу. Буферы принадлежат потоку и переиспользуются между запросами;
+// после запроса обнуляются только встреченные документы, поэтому запрос стоит столько,
+// сколько его списки документов, а не size. Вложенный поиск в том же потоке (из предиката)
+// получает собственные буферы
+class ScoreAccumulator {
+public:
+    enum class State : char { UNSEEN, ACCEPTED, REJECTED };
+
+    explicit ScoreAccumulator(size_t size);
+    ~ScoreAccumulator();
+
+    ScoreAccumulator(const ScoreAccumulator&) = delete;
+    ScoreAccumulator& operator=(const ScoreAccumulator&) = delete;
+
+    State GetState(size_t index) const {
+        return buffers_->states[index];
+    }
+
+    // Документ запоминается как встреченный; вызывать один раз на документ
+    void SetState(size_t index, State state) {
+        buffers_->states[index] = state;
+        buffers_->seen.push_back(index);
+    }
+
+    void Add(size_t index, double contribution) {
+        buffers_->relevance[index] += contribution;
+    }
+
+    double GetRelevance(size_t index) const {
+        return buffers_->relevance[index];
+    }
+
+    // Встреченные документы в порядке первой встречи, после SortSeen — по возрастанию номеров
+    const std::vector<size_t>& GetSeen() const {
+        return buffers_->seen;
+    }
+
+    void SortSeen();
+
+private:
+    struct Buffers {
+        std::vector<double> relevance;
+        std::vector<State> states;
+        std::vector<size_t> seen;
+        bool in_use = false;
+    };
+
+    Buffers own_buffers_;
+    Buffers* buffers_;
+};
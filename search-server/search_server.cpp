@@ -1,5 +1,7 @@
 #include "search_server.h"
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 using namespace std;
 
 SearchServer::SearchServer(const string& stop_words_text)
@@ -13,51 +15,500 @@ SearchServer::SearchServer(const string_view stop_words_text)
     }
 
 set<int>::iterator SearchServer::begin() {
+    BuildDocumentIds();
     return  document_ids_.begin();
 }
 
 set<int>::iterator SearchServer::end() {
+    BuildDocumentIds();
+    return document_ids_.end();
+}
+
+set<int>::const_iterator SearchServer::begin() const {
+    BuildDocumentIds();
+    return document_ids_.begin();
+}
+
+set<int>::const_iterator SearchServer::end() const {
+    BuildDocumentIds();
     return document_ids_.end();
 }
 
 const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    return document_to_word_freqs_.at(document_id);
+    const int ordinal = GetOrdinal(document_id);
+    // Словарь нужен немногим документам, поэтому добавление его не строит
+    lock_guard guard(lazy_state_->word_freqs_mutex);
+    const auto [it, inserted] = word_freqs_.try_emplace(ordinal);
+    if (inserted) {
+        const vector<uint32_t> counts = GetTermCounts(ordinal);
+        const double inv_word_count = 1.0 / word_counts_[ordinal];
+        const TermId* terms = GetDocumentTerms(ordinal).begin();
+        for (size_t i = 0; i < counts.size(); ++i) {
+            it->second.emplace(dictionary_.GetTerm(terms[i]), counts[i] * inv_word_count);
+        }
+    }
+    return it->second;
+}
+
+namespace {
+
+uint64_t MixTermId(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+}  // namespace
+
+DocumentFingerprint SearchServer::GetDocumentFingerprint(int document_id) const {
+    // Сумма хешей слов не зависит от их порядка; половины отпечатка считаются двумя независимыми хешами
+    DocumentFingerprint fingerprint;
+    for (const TermId term_id : GetDocumentTerms(GetOrdinal(document_id))) {
+        fingerprint.low += MixTermId(term_id + 0x9e3779b97f4a7c15ULL);
+        fingerprint.high += MixTermId(term_id + 0xd1b54a32d192ed03ULL);
+    }
+    return fingerprint;
+}
+
+vector<string_view> SearchServer::GetIndexedWords(const string_view text) const {
+    vector<string_view> words;
+    SplitIntoWordsNoStop(text, words);
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
-    document_to_word_freqs_.erase(document_id);
-    for (auto& word : word_to_document_freqs_) {
-        word.second.erase(document_id);
+    if (FindOrdinal(document_id) < 0) {
+        return;
     }
+    RemoveDocument(execution::seq, document_id);
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    MaterializeSnapshotDocuments();
+    bool removed = false;
+    for (const int document_id : document_ids) {
+        const auto ordinal_it = document_to_ordinal_.find(document_id);
+        if (ordinal_it == document_to_ordinal_.end()) {
+            continue;
+        }
+        const int ordinal = ordinal_it->second;
+        for (const TermId term_id : GetDocumentTerms(ordinal)) {
+            --document_freqs_[term_id];
+        }
+        MarkRemoved(ordinal);
+        removed = true;
+    }
+    if (removed) {
+        OnIndexChanged();
+        CompactIndex();
+        RefreshTermWeights();
+    }
+}
+
+void SearchServer::MarkRemoved(int ordinal) {
+    DetachFromSnapshot(ordinal);
+    document_ids_.erase(ordinal_to_document_[ordinal]);
+    document_to_ordinal_.erase(ordinal_to_document_[ordinal]);
+    // Статус не меняется: удалённый документ отмечает только tombstones_, а DocumentStatus::REMOVED —
+    // обычный статус, с которым документ можно добавить и искать
+    ordinal_to_document_[ordinal] = -1;
+    word_freqs_.erase(ordinal);
+    string().swap(document_texts_[ordinal]);
+    tombstones_.Resize(ordinal_to_document_.size());
+    tombstones_.Set(ordinal);
+    removed_ordinals_.push_back(ordinal);
+}
+
+void SearchServer::CompactIndex() {
+    if (removed_ordinals_.empty()) {
+        return;
+    }
+    MaterializeSnapshotDocuments();
+    // Каждый затронутый список перестраивается один раз, сколько бы его документов ни удалили
+    vector<char> is_affected(word_to_document_freqs_.size(), 0);
+    vector<TermId> affected_terms;
+    for (const int ordinal : removed_ordinals_) {
+        for (const TermId term_id : GetDocumentTerms(ordinal)) {
+            if (!is_affected[term_id]) {
+                is_affected[term_id] = 1;
+                affected_terms.push_back(term_id);
+            }
+        }
+    }
+
+    for_each(execution::par, affected_terms.begin(), affected_terms.end(), [this](const TermId term_id) {
+        PostingList& postings = word_to_document_freqs_[term_id];
+        const bool compressed = postings.IsCompressed();
+        postings.Decompress(word_counts_.data());
+        postings.EraseDocuments(tombstones_);
+        if (compressed) {
+            postings.Compress(word_counts_.data());
+        }
+    });
+    for (const TermId term_id : affected_terms) {
+        if (document_freqs_[term_id] == 0) {
+            dictionary_.Erase(term_id);
+            word_to_document_freqs_[term_id] = PostingList();
+            if (term_id < frozen_inverse_document_freqs_.size()) {
+                frozen_inverse_document_freqs_[term_id].reset();
+            }
+        }
+    }
+
+    for (const int ordinal : removed_ordinals_) {
+        tombstones_.Reset(ordinal);
+        ReleaseOrdinal(ordinal);
+    }
+    removed_ordinals_.clear();
+
+    if (dictionary_.NeedsCompaction()) {
+        RelocateTerms();
+    }
+}
+
+void SearchServer::RelocateTerms() {
+    // По старым ключам ещё ищутся номера слов, а выданные наружу слова указывают в старую арену,
+    // поэтому она откладывается до ReleaseRetiredTerms
+    retired_terms_size_ += dictionary_.ArenaSize();
+    retired_terms_.push_back(dictionary_.CompactArena());
+    const auto relocate = [this](map<string_view, double>& word_freqs) {
+        // Порядок ключей не меняется, поэтому узлы переносятся без выделения памяти
+        map<string_view, double> relocated;
+        while (!word_freqs.empty()) {
+            auto node = word_freqs.extract(word_freqs.begin());
+            node.key() = dictionary_.GetTerm(dictionary_.Find(node.key()));
+            relocated.insert(relocated.end(), move(node));
+        }
+        word_freqs.swap(relocated);
+    };
+    for (auto& [ordinal, word_freqs] : word_freqs_) {
+        relocate(word_freqs);
+    }
+}
+
+size_t SearchServer::ReleaseRetiredTerms() {
+    const size_t released = retired_terms_size_;
+    retired_terms_.clear();
+    retired_terms_size_ = 0;
+    return released;
+}
+
+size_t SearchServer::GetTermStorageSize() const {
+    return dictionary_.ArenaSize() + retired_terms_size_;
+}
+
+void SearchServer::SetRetainDocumentTexts(bool retain) {
+    retain_document_texts_ = retain;
+}
+
+string_view SearchServer::GetDocumentText(int document_id) const {
+    return GetOrdinalText(GetOrdinal(document_id));
+}
+
+string_view SearchServer::GetOrdinalText(int ordinal) const {
+    if (IsSnapshotOrdinal(ordinal)) {
+        return snapshot_->GetString(SnapshotSection::TEXT_OFFSETS, SnapshotSection::TEXT_BYTES, ordinal);
+    }
+    return document_texts_[ordinal];
+}
+
+void SearchServer::CompressPostings(size_t min_list_size) {
+    for (PostingList& postings : word_to_document_freqs_) {
+        if (postings.size() >= min_list_size) {
+            postings.Compress(word_counts_.data());
+        }
+    }
+}
+
+void SearchServer::DecompressPostings() {
+    for (PostingList& postings : word_to_document_freqs_) {
+        postings.Decompress(word_counts_.data());
+    }
+}
+
+void SearchServer::SetQueryCacheCapacity(size_t capacity) {
+    query_cache_->SetCapacity(capacity);
+}
+
+QueryCache::Stats SearchServer::GetQueryCacheStats() const {
+    return query_cache_->GetStats();
+}
+
+PostingList& SearchServer::GetMutablePostings(TermId term_id) {
+    PostingList& postings = word_to_document_freqs_[term_id];
+    postings.Decompress(word_counts_.data());
+    return postings;
+}
+
+int SearchServer::AllocateOrdinal(int document_id) {
+    int ordinal;
+    if (free_ordinals_.empty()) {
+        ordinal = static_cast<int>(ordinal_to_document_.size());
+        ordinal_to_document_.push_back(document_id);
+        ratings_.push_back(0);
+        statuses_.push_back(DocumentStatus::ACTUAL);
+        word_counts_.push_back(0);
+        document_terms_.emplace_back();
+        document_term_counts_.emplace_back();
+        document_texts_.emplace_back();
+    }
+    else {
+        ordinal = free_ordinals_.back();
+        free_ordinals_.pop_back();
+        ordinal_to_document_[ordinal] = document_id;
+    }
+    document_to_ordinal_.emplace(document_id, ordinal);
+    return ordinal;
+}
+
+void SearchServer::ReleaseOrdinal(int ordinal) {
+    ratings_[ordinal] = 0;
+    word_counts_[ordinal] = 0;
+    vector<TermId>().swap(document_terms_[ordinal]);
+    vector<uint32_t>().swap(document_term_counts_[ordinal]);
+    free_ordinals_.push_back(ordinal);
 }
 
 
 void SearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status,
     const vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    if ((document_id < 0) || (FindOrdinal(document_id) >= 0)) {
         throw invalid_argument("Invalid document_id"s);
     }
+    MaterializeSnapshotDocuments();
 
-    
-    storage.emplace_back(document);
-    const auto words = SplitIntoWordsNoStop(storage.back());
+    // Буфер слов переиспользуется между вызовами
+    thread_local vector<string_view> words;
+    SplitIntoWordsNoStop(document, words);
 
-    const double inv_word_count = 1.0 / words.size();
+    const int ordinal = AllocateOrdinal(document_id);
+    ratings_[ordinal] = ComputeAverageRating(ratings);
+    statuses_[ordinal] = status;
+    word_counts_[ordinal] = static_cast<int>(words.size());
+    if (retain_document_texts_) {
+        document_texts_[ordinal] = document;
+    }
+
+    vector<TermId> term_ids;
+    term_ids.reserve(words.size());
     for (const string_view word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][word] += inv_word_count;
+        term_ids.push_back(dictionary_.Intern(word));
+    }
+    if (word_to_document_freqs_.size() < dictionary_.size()) {
+        word_to_document_freqs_.resize(dictionary_.size());
+        document_freqs_.resize(dictionary_.size());
+    }
+    sort(term_ids.begin(), term_ids.end());
+
+    const double inv_word_count = 1.0 / words.size();
+    for (auto it = term_ids.begin(); it != term_ids.end();) {
+        const auto run_end = find_if(it, term_ids.end(), [term_id = *it](TermId other) { return other != term_id; });
+        const double term_freq = (run_end - it) * inv_word_count;
+        GetMutablePostings(*it).Insert(ordinal, term_freq);
+        ++document_freqs_[*it];
+        document_terms_[ordinal].push_back(*it);
+        document_term_counts_[ordinal].push_back(static_cast<uint32_t>(run_end - it));
+        it = run_end;
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
     document_ids_.insert(document_id);
+    OnIndexChanged();
 }
 
-vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
-    return SearchServer::FindTopDocuments(
-        raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+vector<AddDocumentError> SearchServer::AddDocuments(const vector<DocumentToAdd>& documents) {
+    return AddDocuments(execution::seq, documents);
+}
+
+vector<char> SearchServer::CheckBatchDocumentIds(const vector<DocumentToAdd>& documents,
+    vector<AddDocumentError>& errors) const {
+    vector<char> accepted(documents.size(), 1);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const int document_id = documents[i].id;
+        if ((document_id < 0) || (document_to_ordinal_.count(document_id) > 0)) {
+            accepted[i] = 0;
+            errors.push_back({ i, document_id, "Invalid document_id"s });
+        }
+    }
+    return accepted;
+}
+
+vector<SearchServer::IngestChunk> SearchServer::MakeIngestChunks(size_t document_count) {
+    // Куски не мельче MIN_INGEST_CHUNK_SIZE документов, чтобы словари кусков не дублировали друг друга
+    constexpr size_t MIN_INGEST_CHUNK_SIZE = 256;
+    const size_t max_chunks = max(thread::hardware_concurrency(), 1u) * PARALLEL_CHUNKS_PER_THREAD;
+    const size_t chunk_count = max<size_t>(1, min(max_chunks, document_count / MIN_INGEST_CHUNK_SIZE));
+    vector<IngestChunk> chunks(chunk_count);
+    for (size_t i = 0; i < chunk_count; ++i) {
+        chunks[i].begin = document_count * i / chunk_count;
+        chunks[i].end = document_count * (i + 1) / chunk_count;
+    }
+    return chunks;
+}
+
+void SearchServer::TokenizeIngestChunk(const vector<DocumentToAdd>& documents, const vector<char>& accepted,
+    IngestChunk& chunk) const {
+    unordered_map<string_view, uint32_t> local_ids;
+    // Вхождения слов текущего документа по локальному номеру
+    vector<uint32_t> counts;
+    vector<string_view> words;
+    chunk.term_begins.reserve(chunk.end - chunk.begin + 1);
+    chunk.word_counts.reserve(chunk.end - chunk.begin);
+    for (size_t i = chunk.begin; i < chunk.end; ++i) {
+        chunk.term_begins.push_back(chunk.terms.size());
+        chunk.word_counts.push_back(0);
+        if (!accepted[i]) {
+            continue;
+        }
+        if (!SplitIntoValidWords(documents[i].text, words)) {
+            chunk.invalid.push_back(i);
+            continue;
+        }
+        const size_t document_terms_begin = chunk.terms.size();
+        int word_count = 0;
+        for (const string_view word : words) {
+            if (IsStopWord(word)) {
+                continue;
+            }
+            ++word_count;
+            const auto [it, inserted] = local_ids.emplace(word, static_cast<uint32_t>(chunk.vocabulary.size()));
+            if (inserted) {
+                chunk.vocabulary.push_back(word);
+                counts.push_back(0);
+            }
+            if (counts[it->second]++ == 0) {
+                chunk.terms.push_back({ it->second, 0 });
+            }
+        }
+        for (size_t j = document_terms_begin; j < chunk.terms.size(); ++j) {
+            chunk.terms[j].second = counts[chunk.terms[j].first];
+            counts[chunk.terms[j].first] = 0;
+        }
+        chunk.word_counts.back() = word_count;
+    }
+    chunk.term_begins.push_back(chunk.terms.size());
+}
+
+void SearchServer::InternIngestChunks(const vector<DocumentToAdd>& documents, vector<char>& accepted,
+    vector<IngestChunk>& chunks, vector<AddDocumentError>& errors) {
+    for (const IngestChunk& chunk : chunks) {
+        for (const size_t i : chunk.invalid) {
+            accepted[i] = 0;
+            errors.push_back({ i, documents[i].id, "Word is invalid"s });
+        }
+    }
+    // Как и при добавлении по одному, из повторяющихся id принимается первый корректный документ
+    unordered_set<int> batch_ids;
+    batch_ids.reserve(documents.size());
+    for (IngestChunk& chunk : chunks) {
+        chunk.local_to_global.assign(chunk.vocabulary.size(), INVALID_TERM_ID);
+        for (size_t i = chunk.begin; i < chunk.end; ++i) {
+            if (!accepted[i]) {
+                continue;
+            }
+            if (!batch_ids.insert(documents[i].id).second) {
+                accepted[i] = 0;
+                errors.push_back({ i, documents[i].id, "Invalid document_id"s });
+                continue;
+            }
+            const size_t position = i - chunk.begin;
+            for (size_t j = chunk.term_begins[position]; j < chunk.term_begins[position + 1]; ++j) {
+                TermId& term_id = chunk.local_to_global[chunk.terms[j].first];
+                if (term_id == INVALID_TERM_ID) {
+                    term_id = dictionary_.Intern(chunk.vocabulary[chunk.terms[j].first]);
+                }
+            }
+        }
+    }
+    if (word_to_document_freqs_.size() < dictionary_.size()) {
+        word_to_document_freqs_.resize(dictionary_.size());
+        document_freqs_.resize(dictionary_.size());
+    }
+}
+
+void SearchServer::MapIngestChunkTerms(const vector<char>& accepted, IngestChunk& chunk) {
+    for (size_t i = chunk.begin; i < chunk.end; ++i) {
+        if (!accepted[i]) {
+            continue;
+        }
+        const size_t position = i - chunk.begin;
+        const auto first = chunk.terms.begin() + chunk.term_begins[position];
+        const auto last = chunk.terms.begin() + chunk.term_begins[position + 1];
+        for (auto it = first; it != last; ++it) {
+            it->first = chunk.local_to_global[it->first];
+        }
+        sort(first, last);
+    }
+}
+
+SearchServer::IngestPlan SearchServer::PlanIngest(const vector<DocumentToAdd>& documents, const vector<char>& accepted,
+    const vector<IngestChunk>& chunks) {
+    IngestPlan plan;
+    // Сколько новых пар у каждого слова, затем — позиция очередной пары слова
+    vector<size_t> term_offsets(dictionary_.size() + 1, 0);
+    for (const IngestChunk& chunk : chunks) {
+        for (size_t i = chunk.begin; i < chunk.end; ++i) {
+            if (!accepted[i]) {
+                continue;
+            }
+            const DocumentToAdd& document = documents[i];
+            const size_t position = i - chunk.begin;
+            const int ordinal = AllocateOrdinal(document.id);
+            ratings_[ordinal] = ComputeAverageRating(document.ratings);
+            statuses_[ordinal] = document.status;
+            word_counts_[ordinal] = chunk.word_counts[position];
+            if (retain_document_texts_) {
+                document_texts_[ordinal] = document.text;
+            }
+            document_ids_.insert(document.id);
+            plan.documents.push_back({ ordinal, &chunk, position });
+            for (size_t j = chunk.term_begins[position]; j < chunk.term_begins[position + 1]; ++j) {
+                ++term_offsets[chunk.terms[j].first + 1];
+            }
+        }
+    }
+
+    plan.term_begins.push_back(0);
+    for (TermId term_id = 0; term_id < dictionary_.size(); ++term_id) {
+        const size_t count = term_offsets[term_id + 1];
+        term_offsets[term_id + 1] = term_offsets[term_id] + count;
+        if (count > 0) {
+            plan.terms.push_back(term_id);
+            plan.term_begins.push_back(term_offsets[term_id + 1]);
+        }
+    }
+
+    plan.postings.resize(plan.term_begins.back());
+    for (const IngestedDocument& document : plan.documents) {
+        const IngestChunk& chunk = *document.chunk;
+        const double inv_word_count = 1.0 / chunk.word_counts[document.position];
+        for (size_t j = chunk.term_begins[document.position]; j < chunk.term_begins[document.position + 1]; ++j) {
+            const auto [term_id, count] = chunk.terms[j];
+            plan.postings[term_offsets[term_id]++] = { document.ordinal, count * inv_word_count };
+        }
+    }
+    return plan;
+}
+
+void SearchServer::FillDocumentTerms(const IngestedDocument& document) {
+    const IngestChunk& chunk = *document.chunk;
+    auto& terms = document_terms_[document.ordinal];
+    auto& counts = document_term_counts_[document.ordinal];
+    const size_t term_count = chunk.term_begins[document.position + 1] - chunk.term_begins[document.position];
+    terms.reserve(term_count);
+    counts.reserve(term_count);
+    for (size_t j = chunk.term_begins[document.position]; j < chunk.term_begins[document.position + 1]; ++j) {
+        const auto [term_id, count] = chunk.terms[j];
+        terms.push_back(term_id);
+        counts.push_back(count);
+    }
+}
+
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status, size_t top_k) const {
+    return FindTopDocumentsWithStatus(execution::seq, raw_query, status, top_k);
 }
 
 vector<Document> SearchServer::FindTopDocuments(const string_view raw_query) const {
@@ -65,35 +516,159 @@ vector<Document> SearchServer::FindTopDocuments(const string_view raw_query) con
 }
 
 
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string>& raw_queries, DocumentStatus status,
+    size_t top_k) const {
+    return FindTopDocumentsBatch(raw_queries, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+        }, top_k);
+}
+
+vector<SearchServer::QueryBatchGroup> SearchServer::PlanQueryBatch(const vector<Query>& queries) const {
+    // Самое длинное слово запроса определяет, сколько он читает; запросы с общим таким словом ставятся рядом
+    vector<pair<TermId, size_t>> order;
+    vector<size_t> query_contributions(queries.size(), 0);
+    order.reserve(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        TermId longest = 0;
+        size_t longest_size = 0;
+        for (const TermId term_id : queries[i].plus_words) {
+            const size_t size = word_to_document_freqs_[term_id].size();
+            query_contributions[i] += size;
+            if (size > longest_size) {
+                longest = term_id;
+                longest_size = size;
+            }
+        }
+        order.emplace_back(longest, i);
+    }
+    sort(order.begin(), order.end());
+
+    vector<QueryBatchGroup> groups;
+    size_t group_contributions = 0;
+    for (const auto& [longest, query] : order) {
+        if (groups.empty()
+            || (group_contributions + query_contributions[query] > BATCH_SEARCH_MAX_CONTRIBUTIONS && group_contributions > 0)) {
+            groups.emplace_back();
+            group_contributions = 0;
+        }
+        groups.back().queries.push_back(query);
+        group_contributions += query_contributions[query];
+    }
+
+    vector<pair<TermId, uint32_t>> term_queries;
+    for (QueryBatchGroup& group : groups) {
+        term_queries.clear();
+        for (size_t i = 0; i < group.queries.size(); ++i) {
+            for (const TermId term_id : queries[group.queries[i]].plus_words) {
+                term_queries.emplace_back(term_id, static_cast<uint32_t>(i));
+            }
+        }
+        // Слова по возрастанию номеров: в каждом запросе вклады складываются в порядке его слов
+        sort(term_queries.begin(), term_queries.end());
+        group.term_queries.reserve(term_queries.size());
+        for (const auto& [term_id, query] : term_queries) {
+            if (group.terms.empty() || group.terms.back() != term_id) {
+                group.terms.push_back(term_id);
+                group.term_begins.push_back(group.term_queries.size());
+            }
+            group.term_queries.push_back(query);
+        }
+        group.term_begins.push_back(group.term_queries.size());
+    }
+    return groups;
+}
+
+vector<Document> SearchServer::CollectBatchDocuments(const Query& query, vector<pair<int, double>>& contributions) const {
+    // Вклады одного слова идут по возрастанию документов, а слова — по возрастанию номеров,
+    // поэтому устойчивая сортировка по документу сохраняет порядок сложения FindTopDocumentsInRange
+    stable_sort(contributions.begin(), contributions.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+        });
+    vector<Document> matched_documents;
+    for (auto it = contributions.begin(); it != contributions.end();) {
+        const int ordinal = it->first;
+        double relevance = 0.0;
+        for (; it != contributions.end() && it->first == ordinal; ++it) {
+            relevance += it->second;
+        }
+        if (!HasMinusWord(query, ordinal)) {
+            matched_documents.push_back({ ordinal_to_document_[ordinal], relevance, ratings_[ordinal] });
+        }
+    }
+    return matched_documents;
+}
+
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    if (snapshot_document_ordinals_ != nullptr) {
+        return static_cast<int>(snapshot_document_count_);
+    }
+    return static_cast<int>(document_to_ordinal_.size());
 }
 
 SearchServer::MatchDocumentResult SearchServer::MatchDocument(const string_view raw_query,
     int document_id) const {
     const auto query = ParseQuery(raw_query, true);
+    const int ordinal = GetOrdinal(document_id);
     vector<string_view> matched_words;
 
-    for (const string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    if (HasMinusWord(query, ordinal)) {
+        return { matched_words, statuses_[ordinal] };
+    }
+
+    for (const TermId term_id : query.plus_words) {
+        if (word_to_document_freqs_[term_id].Contains(ordinal)) {
+            matched_words.push_back(dictionary_.GetTerm(term_id));
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { {}, documents_.at(document_id).status};
+    }
+    sort(matched_words.begin(), matched_words.end());
+
+    return { matched_words, statuses_[ordinal] };
+}
+
+void SearchServer::MatchDocuments(const string_view raw_query, const vector<int>& document_ids,
+    MatchDocumentsResult& result) const {
+    const auto query = ParseQuery(raw_query, true);
+    result.words.clear();
+    result.offsets.assign(1, 0);
+    result.statuses.clear();
+    for (const int document_id : document_ids) {
+        const int ordinal = GetOrdinal(document_id);
+        auto terms = GetDocumentTerms(ordinal);
+        const size_t words_begin = result.words.size();
+        // Номера слов запроса и документа отсортированы, поэтому хватает одного прохода по обоим
+        if (!HasCommonTerm(query.minus_words, terms)) {
+            auto term_it = terms.begin();
+            for (const TermId term_id : query.plus_words) {
+                term_it = lower_bound(term_it, terms.end(), term_id);
+                if (term_it == terms.end()) {
+                    break;
+                }
+                if (*term_it == term_id) {
+                    result.words.push_back(dictionary_.GetTerm(term_id));
+                }
+            }
+            sort(result.words.begin() + words_begin, result.words.end());
         }
+        result.offsets.push_back(result.words.size());
+        result.statuses.push_back(statuses_[ordinal]);
     }
+}
 
-    for (const string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+bool SearchServer::HasCommonTerm(const vector<TermId>& lhs, IteratorRange<const TermId*> rhs) {
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() && rhs_it != rhs.end()) {
+        if (*lhs_it < *rhs_it) {
+            ++lhs_it;
+        }
+        else if (*rhs_it < *lhs_it) {
+            ++rhs_it;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+        else {
+            return true;
         }
     }
-
-    vector<string_view> result{ matched_words.begin(), matched_words.end() };
-    return { result, documents_.at(document_id).status };
+    return false;
 }
 
 bool SearchServer::IsStopWord(const string_view word) const {
@@ -107,17 +682,12 @@ bool SearchServer::IsValidWord(const string_view word) {
         });
 }
 
-vector<string_view> SearchServer::SplitIntoWordsNoStop(const string_view text) const{
-    vector<string_view> words;
-    for (const string_view word : SplitIntoWordsView(text)) {
-        if (!IsValidWord(word)) {
-            throw invalid_argument("Word is invalid"s);
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
+void SearchServer::SplitIntoWordsNoStop(const string_view text, vector<string_view>& words) const {
+    if (!SplitIntoValidWords(text, words)) {
+        throw invalid_argument("Word is invalid"s);
     }
-    return words;
+    words.erase(remove_if(words.begin(), words.end(), [this](const string_view word) { return IsStopWord(word); }),
+        words.end());
 }
 
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
@@ -141,7 +711,8 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
         is_minus = true;
         text = text.substr(1);
     }
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+    // Управляющие символы уже отсеяны при разбиении запроса на слова
+    if (text.empty() || text[0] == '-') {
         throw invalid_argument("Query word is invalid");
     }
 
@@ -151,57 +722,488 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
 
 
 SearchServer::Query SearchServer::ParseQuery(const string_view text, bool sort) const {
+    thread_local vector<string_view> words;
+    if (!SplitIntoValidWords(text, words)) {
+        throw invalid_argument("Query word is invalid");
+    }
     Query result;
-    for (string_view word : SplitIntoWordsView(text)) {
+    for (string_view word : words) {
         const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
-            }
-            else {
-                result.plus_words.push_back(query_word.data);
-            }
+        if (query_word.is_stop) {
+            continue;
+        }
+        const TermId term_id = dictionary_.Find(query_word.data);
+        if (term_id == INVALID_TERM_ID) {
+            continue;
+        }
+        if (query_word.is_minus) {
+            result.minus_words.push_back(term_id);
+        }
+        else {
+            result.plus_words.push_back(term_id);
         }
     }
 
     if (sort)
     {
-        RemoveDuplicateWords(result.minus_words);
-        RemoveDuplicateWords(result.plus_words);
+        for (vector<TermId>* words : { &result.minus_words, &result.plus_words }) {
+            std::sort(words->begin(), words->end());
+            words->erase(unique(words->begin(), words->end()), words->end());
+        }
     }
     return result;
 }
 
-// Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+SearchServer::ExcludedDocuments SearchServer::BuildExcludedDocuments(const Query& query) const {
+    ExcludedDocuments excluded;
+    if (!removed_ordinals_.empty()) {
+        excluded.tombstones = &tombstones_;
+    }
+    size_t minus_count = 0;
+    for (const TermId term_id : query.minus_words) {
+        minus_count += word_to_document_freqs_[term_id].size();
+    }
+    if (minus_count == 0) {
+        return excluded;
+    }
+    // Список из 4-байтовых номеров меньше карты, пока в нём не больше 1/32 всех номеров
+    if (minus_count * 32 < ordinal_to_document_.size()) {
+        excluded.minus_ordinals.reserve(minus_count);
+        for (const TermId term_id : query.minus_words) {
+            for (PostingCursor cursor(word_to_document_freqs_[term_id], word_counts_.data()); !cursor.AtEnd(); cursor.Next()) {
+                excluded.minus_ordinals.push_back(cursor.Ordinal());
+            }
+        }
+        sort(excluded.minus_ordinals.begin(), excluded.minus_ordinals.end());
+        return excluded;
+    }
+    excluded.minus_bitmap.Resize(ordinal_to_document_.size());
+    for (const TermId term_id : query.minus_words) {
+        for (PostingCursor cursor(word_to_document_freqs_[term_id], word_counts_.data()); !cursor.AtEnd(); cursor.Next()) {
+            excluded.minus_bitmap.Set(cursor.Ordinal());
+        }
+    }
+    return excluded;
+}
+
+vector<double> SearchServer::GetInverseDocumentFreqs(const Query& query) const {
+    vector<double> inverse_document_freqs(query.plus_words.size());
+    std::transform(query.plus_words.begin(), query.plus_words.end(), inverse_document_freqs.begin(),
+        [this](const TermId term_id) { return GetTermWeights(term_id).inverse_document_freq; });
+    return inverse_document_freqs;
+}
+
+bool SearchServer::HasMinusWord(const Query& query, int ordinal) const {
+    return any_of(query.minus_words.begin(), query.minus_words.end(), [this, ordinal](const TermId term_id) {
+        return word_to_document_freqs_[term_id].Contains(ordinal);
+        });
+}
+
+void SearchServer::RefreshTermWeights() {
+    if (term_weights_frozen_ && term_weights_stale_) {
+        RebuildTermWeights();
+    }
+}
+
+void SearchServer::FreezeTermWeights(bool frozen) {
+    term_weights_frozen_ = frozen;
+    if (frozen) {
+        RebuildTermWeights();
+    }
+    else {
+        frozen_inverse_document_freqs_.clear();
+        ++generation_;
+    }
+}
+
+void SearchServer::OnIndexChanged() {
+    ++generation_;
+    // Таблица пересчитывается за O(словаря), поэтому не на каждый документ
+    term_weights_stale_ = true;
+}
+
+SearchServer::TermWeights SearchServer::GetTermWeights(TermId term_id) const {
+    TermWeights weights;
+    if (term_id < frozen_inverse_document_freqs_.size() && frozen_inverse_document_freqs_[term_id]) {
+        weights.inverse_document_freq = *frozen_inverse_document_freqs_[term_id];
+    }
+    else if (document_freqs_[term_id] != 0) {
+        weights.inverse_document_freq = ComputeInverseDocumentFreq(term_id);
+    }
+    // Наибольшая частота берётся из текущего списка, так что оценка остаётся верхней и при устаревшем IDF
+    weights.max_score = word_to_document_freqs_[term_id].MaxTermFreq() * weights.inverse_document_freq;
+    return weights;
+}
+
+double SearchServer::ComputeInverseDocumentFreq(TermId term_id) const {
+    return log(GetDocumentCount() * 1.0 / document_freqs_[term_id]);
+}
+
+void SearchServer::RebuildTermWeights() {
+    frozen_inverse_document_freqs_.assign(word_to_document_freqs_.size(), nullopt);
+    for (size_t term_id = 0; term_id < word_to_document_freqs_.size(); ++term_id) {
+        if (document_freqs_[term_id] != 0) {
+            frozen_inverse_document_freqs_[term_id] = ComputeInverseDocumentFreq(static_cast<TermId>(term_id));
+        }
+    }
+    term_weights_stale_ = false;
+    // Кеш мог сохранить результаты с прежними IDF
+    ++generation_;
 }
 
 
 SearchServer::MatchDocumentResult SearchServer::MatchDocument(const std::execution::parallel_policy&, const std::string_view raw_query,
     int document_id) const {
-    if (document_ids_.count(document_id) == 0) {
+    const int ordinal = FindOrdinal(document_id);
+    if (ordinal < 0) {
         throw std::out_of_range("Invalid document_id.");
     }
     auto query = ParseQuery(raw_query, false);
     std::vector<std::string_view> matched_words;
 
-    if (std::none_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [this, document_id](const std::string_view word)
-        {return word_to_document_freqs_.at(word).count(document_id); })) {
+    if (std::none_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [this, ordinal](const TermId term_id)
+        {return word_to_document_freqs_[term_id].Contains(ordinal); })) {
 
-        matched_words.resize(query.plus_words.size());
-        auto it = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(),
-            [this, document_id](const std::string_view word)
-            {return word_to_document_freqs_.at(word).count(document_id); });
-        RemoveDuplicateWords(std::execution::par, matched_words, it);
+        std::vector<TermId> matched_terms(query.plus_words.size());
+        auto it = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_terms.begin(),
+            [this, ordinal](const TermId term_id)
+            {return word_to_document_freqs_[term_id].Contains(ordinal); });
+        matched_words.resize(it - matched_terms.begin());
+        std::transform(std::execution::par, matched_terms.begin(), it, matched_words.begin(),
+            [this](const TermId term_id) {return dictionary_.GetTerm(term_id); });
+        RemoveDuplicateWords(std::execution::par, matched_words, matched_words.end());
 
     }
 
-    vector<string_view> result{ matched_words.begin(), matched_words.end() };
-    return { result, documents_.at(document_id).status };
+    return { matched_words, statuses_[ordinal] };
 }
 
 SearchServer::MatchDocumentResult SearchServer::MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query,
     int document_id) const {
     return MatchDocument(raw_query, document_id);
-}
\ No newline at end of file
+}
+
+namespace {
+
+template <typename GetString>
+void WriteStrings(SnapshotWriter& writer, SnapshotSection offsets_section, SnapshotSection bytes_section,
+    size_t count, GetString get_string) {
+    vector<uint64_t> offsets{ 0 };
+    string bytes;
+    for (size_t i = 0; i < count; ++i) {
+        bytes += get_string(i);
+        offsets.push_back(bytes.size());
+    }
+    writer.Write(offsets_section, offsets);
+    writer.Write(bytes_section, bytes.data(), bytes.size());
+}
+
+set<string, less<>> ReadStopWords(const Snapshot& snapshot) {
+    if (!snapshot.HasValidOffsets(SnapshotSection::STOP_WORD_OFFSETS, snapshot.Count<char>(SnapshotSection::STOP_WORD_BYTES))) {
+        throw runtime_error("Snapshot is corrupted"s);
+    }
+    set<string, less<>> stop_words;
+    for (size_t i = 0; i + 1 < snapshot.Count<uint64_t>(SnapshotSection::STOP_WORD_OFFSETS); ++i) {
+        stop_words.emplace(snapshot.GetString(SnapshotSection::STOP_WORD_OFFSETS, SnapshotSection::STOP_WORD_BYTES, i));
+    }
+    return stop_words;
+}
+
+}  // namespace
+
+void SearchServer::SaveSnapshot(const string& path) const {
+    SnapshotWriter writer(path);
+    writer.Write(SnapshotSection::SETTINGS, vector<uint32_t>{ retain_document_texts_, term_weights_frozen_ });
+    const vector<string_view> stop_words(stop_words_.begin(), stop_words_.end());
+    WriteStrings(writer, SnapshotSection::STOP_WORD_OFFSETS, SnapshotSection::STOP_WORD_BYTES, stop_words.size(),
+        [&stop_words](size_t i) { return stop_words[i]; });
+
+    const size_t term_count = dictionary_.size();
+    WriteStrings(writer, SnapshotSection::TERM_OFFSETS, SnapshotSection::TERM_BYTES, term_count,
+        [this](size_t term_id) { return dictionary_.GetTerm(static_cast<TermId>(term_id)); });
+    writer.Write(SnapshotSection::FREE_TERM_IDS, dictionary_.FreeTermIds());
+
+    // Списки пишутся в сжатом виде, чтобы после загрузки читать их прямо из файла
+    vector<double> max_term_freqs(term_count);
+    vector<uint64_t> posting_sizes(term_count);
+    vector<uint64_t> block_offsets{ 0 };
+    vector<uint64_t> data_offsets{ 0 };
+    vector<PostingList::Block> blocks;
+    vector<uint8_t> data;
+    for (TermId term_id = 0; term_id < term_count; ++term_id) {
+        const PostingList& source = word_to_document_freqs_[term_id];
+        PostingList compressed;
+        const PostingList* postings = &source;
+        if (!source.IsCompressed()) {
+            compressed = source;
+            compressed.Compress(word_counts_.data());
+            postings = &compressed;
+        }
+        max_term_freqs[term_id] = source.MaxTermFreq();
+        posting_sizes[term_id] = source.size();
+        blocks.insert(blocks.end(), postings->Blocks(), postings->Blocks() + postings->BlockCount());
+        data.insert(data.end(), postings->CompressedData(), postings->CompressedData() + postings->CompressedDataSize());
+        block_offsets.push_back(blocks.size());
+        data_offsets.push_back(data.size());
+    }
+    writer.Write(SnapshotSection::DOCUMENT_FREQS, document_freqs_);
+    writer.Write(SnapshotSection::MAX_TERM_FREQS, max_term_freqs);
+    writer.Write(SnapshotSection::POSTING_SIZES, posting_sizes);
+    writer.Write(SnapshotSection::BLOCK_OFFSETS, block_offsets);
+    writer.Write(SnapshotSection::BLOCKS, blocks);
+    writer.Write(SnapshotSection::POSTING_DATA_OFFSETS, data_offsets);
+    writer.Write(SnapshotSection::POSTING_DATA, data);
+
+    const size_t ordinal_count = ordinal_to_document_.size();
+    vector<int> statuses(ordinal_count);
+    transform(statuses_.data(), statuses_.data() + ordinal_count, statuses.begin(),
+        [](DocumentStatus status) { return static_cast<int>(status); });
+    vector<int> document_ordinals;
+    if (snapshot_document_ordinals_ != nullptr) {
+        document_ordinals.assign(snapshot_document_ordinals_, snapshot_document_ordinals_ + snapshot_document_count_);
+    }
+    else {
+        document_ordinals.reserve(document_to_ordinal_.size());
+        for (const auto& [document_id, ordinal] : document_to_ordinal_) {
+            document_ordinals.push_back(ordinal);
+        }
+    }
+    writer.Write(SnapshotSection::ORDINAL_TO_DOCUMENT, ordinal_to_document_.data(), ordinal_count * sizeof(int));
+    writer.Write(SnapshotSection::DOCUMENT_ORDINALS, document_ordinals);
+    writer.Write(SnapshotSection::RATINGS, ratings_.data(), ordinal_count * sizeof(int));
+    writer.Write(SnapshotSection::STATUSES, statuses);
+    writer.Write(SnapshotSection::WORD_COUNTS, word_counts_.data(), ordinal_count * sizeof(int));
+
+    vector<uint64_t> forward_offsets{ 0 };
+    vector<TermId> forward_terms;
+    vector<uint32_t> forward_counts;
+    for (int ordinal = 0; ordinal < static_cast<int>(ordinal_count); ++ordinal) {
+        const vector<uint32_t> counts = GetTermCounts(ordinal);
+        auto terms = GetDocumentTerms(ordinal);
+        forward_terms.insert(forward_terms.end(), terms.begin(), terms.end());
+        forward_counts.insert(forward_counts.end(), counts.begin(), counts.end());
+        forward_offsets.push_back(forward_terms.size());
+    }
+    writer.Write(SnapshotSection::FORWARD_OFFSETS, forward_offsets);
+    writer.Write(SnapshotSection::FORWARD_TERMS, forward_terms);
+    writer.Write(SnapshotSection::FORWARD_COUNTS, forward_counts);
+    writer.Write(SnapshotSection::FREE_ORDINALS, free_ordinals_);
+    writer.Write(SnapshotSection::REMOVED_ORDINALS, removed_ordinals_);
+    WriteStrings(writer, SnapshotSection::TEXT_OFFSETS, SnapshotSection::TEXT_BYTES, ordinal_count,
+        [this](size_t ordinal) { return GetOrdinalText(static_cast<int>(ordinal)); });
+    writer.Finish();
+}
+
+SearchServer SearchServer::LoadSnapshot(const string& path, bool verify_checksum) {
+    return SearchServer(make_shared<const Snapshot>(path, verify_checksum));
+}
+
+SearchServer::SearchServer(shared_ptr<const Snapshot> snapshot)
+    : stop_words_(ReadStopWords(*snapshot))
+    , snapshot_(move(snapshot)) {
+    const Snapshot& s = *snapshot_;
+    const auto require = [](bool condition) {
+        if (!condition) {
+            throw runtime_error("Snapshot is corrupted"s);
+        }
+    };
+    require(s.Count<uint32_t>(SnapshotSection::SETTINGS) == 2 && s.Count<uint64_t>(SnapshotSection::TERM_OFFSETS) > 0
+        && s.Count<uint64_t>(SnapshotSection::TEXT_OFFSETS) > 0);
+    const size_t term_count = s.Count<uint64_t>(SnapshotSection::TERM_OFFSETS) - 1;
+    const size_t ordinal_count = s.Count<int>(SnapshotSection::ORDINAL_TO_DOCUMENT);
+    require(s.Count<int>(SnapshotSection::DOCUMENT_FREQS) == term_count
+        && s.Count<double>(SnapshotSection::MAX_TERM_FREQS) == term_count
+        && s.Count<uint64_t>(SnapshotSection::POSTING_SIZES) == term_count
+        && s.Count<uint64_t>(SnapshotSection::BLOCK_OFFSETS) == term_count + 1
+        && s.Count<uint64_t>(SnapshotSection::POSTING_DATA_OFFSETS) == term_count + 1
+        && s.Count<int>(SnapshotSection::DOCUMENT_ORDINALS) <= ordinal_count
+        && s.Count<int>(SnapshotSection::RATINGS) == ordinal_count
+        && s.Count<int>(SnapshotSection::STATUSES) == ordinal_count
+        && s.Count<int>(SnapshotSection::WORD_COUNTS) == ordinal_count
+        && s.Count<uint64_t>(SnapshotSection::FORWARD_OFFSETS) == ordinal_count + 1
+        && s.Count<uint64_t>(SnapshotSection::TEXT_OFFSETS) == ordinal_count + 1);
+
+    // Всё, что используется как номер или смещение, проверяется до первого обращения по нему:
+    // иначе повреждённый файл приводит к записи за границы массивов
+    const uint64_t* block_offsets = s.Data<uint64_t>(SnapshotSection::BLOCK_OFFSETS);
+    const uint64_t* data_offsets = s.Data<uint64_t>(SnapshotSection::POSTING_DATA_OFFSETS);
+    const uint64_t* forward_offsets = s.Data<uint64_t>(SnapshotSection::FORWARD_OFFSETS);
+    require(s.HasValidOffsets(SnapshotSection::TERM_OFFSETS, s.Count<char>(SnapshotSection::TERM_BYTES))
+        && s.HasValidOffsets(SnapshotSection::TEXT_OFFSETS, s.Count<char>(SnapshotSection::TEXT_BYTES))
+        && s.HasValidOffsets(SnapshotSection::BLOCK_OFFSETS, s.Count<PostingList::Block>(SnapshotSection::BLOCKS))
+        && s.HasValidOffsets(SnapshotSection::POSTING_DATA_OFFSETS, s.Count<uint8_t>(SnapshotSection::POSTING_DATA))
+        && s.HasValidOffsets(SnapshotSection::FORWARD_OFFSETS, s.Count<TermId>(SnapshotSection::FORWARD_TERMS))
+        && forward_offsets[ordinal_count] == s.Count<uint32_t>(SnapshotSection::FORWARD_COUNTS));
+    const auto all_below = [](const auto* values, size_t count, size_t limit) {
+        return all_of(values, values + count, [limit](const auto value) { return static_cast<uint64_t>(static_cast<int64_t>(value)) < limit; });
+    };
+    require(all_below(s.Data<TermId>(SnapshotSection::FREE_TERM_IDS), s.Count<TermId>(SnapshotSection::FREE_TERM_IDS), term_count)
+        && all_below(s.Data<TermId>(SnapshotSection::FORWARD_TERMS), s.Count<TermId>(SnapshotSection::FORWARD_TERMS), term_count)
+        && all_below(s.Data<int>(SnapshotSection::FREE_ORDINALS), s.Count<int>(SnapshotSection::FREE_ORDINALS), ordinal_count)
+        && all_below(s.Data<int>(SnapshotSection::REMOVED_ORDINALS), s.Count<int>(SnapshotSection::REMOVED_ORDINALS), ordinal_count)
+        && all_below(s.Data<int>(SnapshotSection::DOCUMENT_ORDINALS), s.Count<int>(SnapshotSection::DOCUMENT_ORDINALS), ordinal_count));
+    // Поиск id двоичным поиском требует живых документов строго по возрастанию id
+    const int* ordinal_to_document = s.Data<int>(SnapshotSection::ORDINAL_TO_DOCUMENT);
+    const int* document_ordinals = s.Data<int>(SnapshotSection::DOCUMENT_ORDINALS);
+    for (size_t i = 0; i < s.Count<int>(SnapshotSection::DOCUMENT_ORDINALS); ++i) {
+        require(ordinal_to_document[document_ordinals[i]] >= 0
+            && (i == 0 || ordinal_to_document[document_ordinals[i - 1]] < ordinal_to_document[document_ordinals[i]]));
+    }
+    // Блоки списка лежат внутри его данных, id концов блоков растут и меньше числа внутренних номеров
+    const PostingList::Block* all_blocks = s.Data<PostingList::Block>(SnapshotSection::BLOCKS);
+    const uint64_t* all_posting_sizes = s.Data<uint64_t>(SnapshotSection::POSTING_SIZES);
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        uint64_t posting_count = 0;
+        int previous_last = -1;
+        for (uint64_t block = block_offsets[term_id]; block < block_offsets[term_id + 1]; ++block) {
+            const PostingList::Block& b = all_blocks[block];
+            require(b.size > 0 && b.size <= POSTING_BLOCK_SIZE && b.offset < data_offsets[term_id + 1] - data_offsets[term_id]
+                && b.last_document_id > previous_last && static_cast<size_t>(b.last_document_id) < ordinal_count);
+            previous_last = b.last_document_id;
+            posting_count += b.size;
+        }
+        require(posting_count == all_posting_sizes[term_id]);
+    }
+
+    vector<string_view> terms(term_count);
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        terms[term_id] = s.GetString(SnapshotSection::TERM_OFFSETS, SnapshotSection::TERM_BYTES, term_id);
+    }
+    const TermId* free_term_ids = s.Data<TermId>(SnapshotSection::FREE_TERM_IDS);
+    dictionary_.AssignExternal(move(terms),
+        vector<TermId>(free_term_ids, free_term_ids + s.Count<TermId>(SnapshotSection::FREE_TERM_IDS)));
+
+    const PostingList::Block* blocks = s.Data<PostingList::Block>(SnapshotSection::BLOCKS);
+    const uint8_t* data = s.Data<uint8_t>(SnapshotSection::POSTING_DATA);
+    const uint64_t* posting_sizes = s.Data<uint64_t>(SnapshotSection::POSTING_SIZES);
+    const double* max_term_freqs = s.Data<double>(SnapshotSection::MAX_TERM_FREQS);
+    word_to_document_freqs_.resize(term_count);
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        word_to_document_freqs_[term_id].AssignExternal(blocks + block_offsets[term_id],
+            block_offsets[term_id + 1] - block_offsets[term_id], data + data_offsets[term_id],
+            data_offsets[term_id + 1] - data_offsets[term_id], posting_sizes[term_id], max_term_freqs[term_id]);
+    }
+    const int* document_freqs = s.Data<int>(SnapshotSection::DOCUMENT_FREQS);
+    document_freqs_.assign(document_freqs, document_freqs + term_count);
+
+    // Таблицы по внутренним номерам документов не копируются: до первого изменения индекса
+    // метаданные, прямой индекс, тексты и поиск id читаются из файла
+    static_assert(sizeof(DocumentStatus) == sizeof(int));
+    ordinal_to_document_.AssignExternal(s.Data<int>(SnapshotSection::ORDINAL_TO_DOCUMENT), ordinal_count);
+    ratings_.AssignExternal(s.Data<int>(SnapshotSection::RATINGS), ordinal_count);
+    statuses_.AssignExternal(s.Data<DocumentStatus>(SnapshotSection::STATUSES), ordinal_count);
+    word_counts_.AssignExternal(s.Data<int>(SnapshotSection::WORD_COUNTS), ordinal_count);
+    snapshot_ordinal_count_ = ordinal_count;
+    snapshot_document_ordinals_ = s.Data<int>(SnapshotSection::DOCUMENT_ORDINALS);
+    snapshot_document_count_ = s.Count<int>(SnapshotSection::DOCUMENT_ORDINALS);
+
+    const int* free_ordinals = s.Data<int>(SnapshotSection::FREE_ORDINALS);
+    const int* removed_ordinals = s.Data<int>(SnapshotSection::REMOVED_ORDINALS);
+    free_ordinals_.assign(free_ordinals, free_ordinals + s.Count<int>(SnapshotSection::FREE_ORDINALS));
+    removed_ordinals_.assign(removed_ordinals, removed_ordinals + s.Count<int>(SnapshotSection::REMOVED_ORDINALS));
+    if (!removed_ordinals_.empty()) {
+        tombstones_.Resize(ordinal_count);
+    }
+    for (const int ordinal : removed_ordinals_) {
+        tombstones_.Set(ordinal);
+    }
+
+    const uint32_t* settings = s.Data<uint32_t>(SnapshotSection::SETTINGS);
+    retain_document_texts_ = settings[0] != 0;
+    term_weights_frozen_ = settings[1] != 0;
+    if (term_weights_frozen_) {
+        RebuildTermWeights();
+    }
+}
+
+void SearchServer::MaterializeSnapshotDocuments() {
+    if (snapshot_document_ordinals_ == nullptr) {
+        return;
+    }
+    BuildDocumentIds();
+    for (size_t i = 0; i < snapshot_document_count_; ++i) {
+        const int ordinal = snapshot_document_ordinals_[i];
+        document_to_ordinal_.emplace_hint(document_to_ordinal_.end(), ordinal_to_document_[ordinal], ordinal);
+    }
+    snapshot_document_ordinals_ = nullptr;
+    snapshot_document_count_ = 0;
+
+    const size_t ordinal_count = ordinal_to_document_.size();
+    document_terms_.resize(ordinal_count);
+    document_term_counts_.resize(ordinal_count);
+    document_texts_.resize(ordinal_count);
+    snapshot_documents_.assign(ordinal_count, 1);
+    // Освобождённые номера достанутся новым документам; слова удалённых нужны до уплотнения
+    for (const int ordinal : free_ordinals_) {
+        snapshot_documents_[ordinal] = 0;
+    }
+    for (const int ordinal : removed_ordinals_) {
+        DetachFromSnapshot(ordinal);
+    }
+}
+
+void SearchServer::BuildDocumentIds() const {
+    if (snapshot_document_ordinals_ == nullptr) {
+        return;
+    }
+    call_once(lazy_state_->document_ids_built, [this] {
+        for (size_t i = 0; i < snapshot_document_count_; ++i) {
+            document_ids_.insert(document_ids_.end(), ordinal_to_document_[snapshot_document_ordinals_[i]]);
+        }
+        });
+}
+
+bool SearchServer::IsSnapshotOrdinal(int ordinal) const {
+    return static_cast<size_t>(ordinal) < snapshot_ordinal_count_
+        && (snapshot_documents_.empty() || snapshot_documents_[ordinal]);
+}
+
+void SearchServer::DetachFromSnapshot(int ordinal) {
+    if (!IsSnapshotOrdinal(ordinal)) {
+        return;
+    }
+    auto terms = GetDocumentTerms(ordinal);
+    document_terms_[ordinal].assign(terms.begin(), terms.end());
+    document_term_counts_[ordinal] = GetTermCounts(ordinal);
+    snapshot_documents_[ordinal] = 0;
+}
+
+int SearchServer::FindOrdinal(int document_id) const {
+    if (snapshot_document_ordinals_ != nullptr) {
+        const int* last = snapshot_document_ordinals_ + snapshot_document_count_;
+        const int* it = lower_bound(snapshot_document_ordinals_, last, document_id, [this](int ordinal, int id) {
+            return ordinal_to_document_[ordinal] < id;
+            });
+        return it != last && ordinal_to_document_[*it] == document_id ? *it : -1;
+    }
+    const auto it = document_to_ordinal_.find(document_id);
+    return it != document_to_ordinal_.end() ? it->second : -1;
+}
+
+int SearchServer::GetOrdinal(int document_id) const {
+    const int ordinal = FindOrdinal(document_id);
+    if (ordinal < 0) {
+        throw out_of_range("Invalid document_id"s);
+    }
+    return ordinal;
+}
+
+IteratorRange<const TermId*> SearchServer::GetDocumentTerms(int ordinal) const {
+    if (IsSnapshotOrdinal(ordinal)) {
+        const TermId* terms = snapshot_->Data<TermId>(SnapshotSection::FORWARD_TERMS);
+        const uint64_t* offsets = snapshot_->Data<uint64_t>(SnapshotSection::FORWARD_OFFSETS);
+        return { terms + offsets[ordinal], terms + offsets[ordinal + 1] };
+    }
+    const vector<TermId>& terms = document_terms_[ordinal];
+    return { terms.data(), terms.data() + terms.size() };
+}
+
+vector<uint32_t> SearchServer::GetTermCounts(int ordinal) const {
+    auto terms = GetDocumentTerms(ordinal);
+    if (IsSnapshotOrdinal(ordinal)) {
+        const uint32_t* counts = snapshot_->Data<uint32_t>(SnapshotSection::FORWARD_COUNTS)
+            + snapshot_->Data<uint64_t>(SnapshotSection::FORWARD_OFFSETS)[ordinal];
+        return vector<uint32_t>(counts, counts + terms.size());
+    }
+    return document_term_counts_[ordinal];
+}
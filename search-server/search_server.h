@@ -1,18 +1,45 @@
 ﻿#pragma once
 #include <map>
+#include <memory>
+#include <mutex>
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <stdexcept>
 #include <utility>
 #include <execution>
-#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <unordered_map>
 #include "string_processing.h"
-#include "concurrent_map.h"
 #include "document.h"
+#include "document_bitmap.h"
+#include "external_array.h"
+#include "paginator.h"
+#include "posting_list.h"
+#include "query_cache.h"
+#include "score_accumulator.h"
+#include "snapshot.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double MAX_INACCURACY = 1e-6;
-constexpr int MAP_BASKET_COUNT = 100;
+// Кусков на поток при параллельном поиске: несколько, чтобы потоки не простаивали
+constexpr unsigned PARALLEL_CHUNKS_PER_THREAD = 4;
+constexpr int MIN_PARALLEL_CHUNK_SIZE = 4096;
+constexpr size_t TOMBSTONE_COMPACTION_RATIO = 4;
+// Сколько пар (документ, вклад слова) пакетный поиск копит за один проход по спискам документов
+constexpr size_t BATCH_SEARCH_MAX_CONTRIBUTIONS = size_t{ 1 } << 22;
+
+namespace search_policy {
+
+// Поиск с динамическим отсечением (MaxScore): документы, которые по верхней оценке
+// релевантности не могут попасть в выдачу, не дооцениваются. Выдача та же, что при полном переборе
+struct MaxScorePolicy {};
+inline constexpr MaxScorePolicy max_score{};
+
+}  // namespace search_policy
 
 class SearchServer {
 public:
@@ -21,37 +48,100 @@ public:
 
     explicit SearchServer(const std::string& stop_words_text);
     explicit SearchServer(const std::string_view stop_words_text);
+
+    // При перемещении слова словаря остаются на месте, и выданные string_view не портятся.
+    // Копирования нет: ключи словарей частот документов указывают в словарь исходного сервера
+    SearchServer(SearchServer&&) = default;
+    SearchServer(const SearchServer&) = delete;
    
     std::set<int>::iterator begin();
     std::set<int>::iterator end();
+    std::set<int>::const_iterator begin() const;
+    std::set<int>::const_iterator end() const;
 
+    // Словарь строится при первом вызове для документа и живёт до его удаления.
+    // Ключи указывают в словарь индекса и действительны, пока жив сервер (см. ReleaseRetiredTerms)
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Не зависит от порядка слов и числа их вхождений: у документов индекса с одинаковыми
+    // множествами слов отпечатки совпадают. Можно вызывать из нескольких потоков
+    DocumentFingerprint GetDocumentFingerprint(int document_id) const;
+    // Различные слова текста, как их проиндексировал бы AddDocument: без стоп-слов, по возрастанию.
+    // Для недопустимых слов бросает std::invalid_argument
+    std::vector<std::string_view> GetIndexedWords(const std::string_view text) const;
+
+    // По умолчанию индекс хранит только байты различных слов, а не тексты документов.
+    // Если текст нужен, хранение включается до добавления документов; текст освобождается при удалении
+    void SetRetainDocumentTexts(bool retain);
+    // Пустая строка, если текст документа не хранился
+    std::string_view GetDocumentText(int document_id) const;
 
     void RemoveDocument(int document_id);
 
     template<typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
 
+    // Удаление помечает документ (tombstone), и поиск его пропускает; из списков документов слов
+    // он вычищается при уплотнении индекса. Уплотнение запускается само, когда помеченных
+    // становится больше 1 / TOMBSTONE_COMPACTION_RATIO внутренних номеров, или через CompactIndex.
+    // RemoveDocuments помечает все документы и уплотняет индекс один раз; неизвестные id пропускаются
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    // Уплотнение индекса заодно переносит слова словаря в новую арену,
+    // если удалённые слова занимают в ней больше половины
+    void CompactIndex();
+    // Уплотнение словаря переносит слова в новую арену, а старую откладывает: слова, уже выданные
+    // MatchDocument, MatchDocuments и GetWordFrequencies, остаются действительными.
+    // ReleaseRetiredTerms освобождает отложенные арены, когда вызывающий больше не держит
+    // полученных до этого представлений слов. Возвращает число освобождённых байт
+    size_t ReleaseRetiredTerms();
+    // Байт выделено под слова словаря, включая отложенные арены
+    size_t GetTermStorageSize() const;
+
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
         const std::vector<int>& ratings);   
 
+    // Пакетное добавление: документы разбираются на слова параллельно, каждый поток строит
+    // частичный индекс своего куска, затем списки слов пополняются одним слиянием на слово.
+    // Результат тот же, что у AddDocument по порядку. Документы с ошибками пропускаются
+    // и возвращаются с текстом исключения, которое бросил бы AddDocument
+    template <typename ExecutionPolicy>
+    std::vector<AddDocumentError> AddDocuments(ExecutionPolicy&& policy, const std::vector<DocumentToAdd>& documents);
+    std::vector<AddDocumentError> AddDocuments(const std::vector<DocumentToAdd>& documents);
+
+    // top_k — сколько лучших документов вернуть.
+    // Вместо политики выполнения можно передать search_policy::max_score.
+    // Результаты поиска по статусу кешируются; поиск с произвольным предикатом идёт мимо кеша
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query,
-        DocumentPredicate document_predicate) const;
+        DocumentPredicate document_predicate, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename DocumentPredicate, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query,
-        DocumentPredicate document_predicate) const;
+        DocumentPredicate document_predicate, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
 
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+        size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status,
+        size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
 
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const;
 
+    // Пакетный поиск для офлайн-обработки: запросы группируются по словам, и список документов
+    // слова читается один раз на группу запросов, а не на каждый запрос.
+    // Выдача по каждому запросу та же, что у FindTopDocuments; кеш не используется
+    template <typename DocumentPredicate>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+        DocumentPredicate document_predicate, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
     int GetDocumentCount() const;
 
+    // Правила для слов и рейтинга документа; по ним же работает SegmentedIndex
+    static bool IsValidWord(const std::string_view word);
+    static int ComputeAverageRating(const std::vector<int>& ratings);
+
     using MatchDocumentResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
     MatchDocumentResult MatchDocument(const std::string_view raw_query,
         int document_id) const;
@@ -60,29 +150,210 @@ public:
     MatchDocumentResult MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query,
         int document_id) const;
 
+    // Результаты MatchDocuments в одном буфере: совпавшие слова i-го документа лежат
+    // в words[offsets[i], offsets[i + 1]). Буфер переиспользуется между вызовами без новых выделений памяти
+    struct MatchDocumentsResult {
+        std::vector<std::string_view> words;
+        std::vector<size_t> offsets{ 0 };
+        std::vector<DocumentStatus> statuses;
+
+        size_t size() const {
+            return statuses.size();
+        }
+
+        IteratorRange<std::vector<std::string_view>::const_iterator> operator[](size_t index) const {
+            return { words.begin() + offsets[index], words.begin() + offsets[index + 1] };
+        }
+    };
+    // То же, что MatchDocument для каждого документа, но запрос разбирается один раз,
+    // а слова сверяются слиянием с отсортированными номерами слов документа.
+    // Для неизвестного id бросает std::out_of_range
+    void MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids,
+        MatchDocumentsResult& result) const;
+
     std::map<int, std::set<std::string>> GetDocumentWords(int doc_id);
 
+    // Сжимает списки документов слов, в которых не меньше min_list_size документов:
+    // память против скорости — короткие списки выгоднее оставить как есть.
+    // Список, в который добавляется или из которого удаляется документ, снова разжимается
+    void CompressPostings(size_t min_list_size = 0);
+    void DecompressPostings();
+
+    // IDF и верхние оценки для MaxScore поиск считает только для слов запроса, по текущему индексу.
+    // После FreezeTermWeights IDF берутся из таблицы, посчитанной для всех слов, — для индексов,
+    // которые редко меняются. Таблицу пересчитывают FreezeTermWeights, RefreshTermWeights, AddDocuments
+    // и RemoveDocuments; после AddDocument и RemoveDocument по одному IDF слов из таблицы не меняются
+    // до RefreshTermWeights, и релевантность приблизительна (IDF слов не из таблицы считаются по текущему индексу).
+    // Без заморозки RefreshTermWeights ничего не делает
+    void RefreshTermWeights();
+    void FreezeTermWeights(bool frozen = true);
+
+    // 0 выключает кеш результатов поиска
+    void SetQueryCacheCapacity(size_t capacity);
+    QueryCache::Stats GetQueryCacheStats() const;
+
+    // Снимок индекса целиком: стоп-слова, словарь, сжатые списки документов, прямой индекс,
+    // метаданные и тексты документов. Формат версионирован и защищён контрольной суммой.
+    // LoadSnapshot отображает файл в память и не копирует данные документов: списки документов,
+    // слова, прямой индекс, метаданные и поиск id идут прямо по файлу, словари частот документов
+    // строятся при первом GetWordFrequencies, множество id — при первом обходе сервера.
+    // Первое изменение индекса копирует в память таблицы документов (но не списки и не прямой индекс).
+    // Номера, смещения и границы блоков проверяются при загрузке всегда. verify_checksum сверяет ещё и
+    // контрольную сумму, читая весь файл: отключать её можно только для файлов, которым доверяют,
+    // иначе повреждённые данные сжатых списков не обнаруживаются. Ошибки чтения и записи — std::runtime_error
+    void SaveSnapshot(const std::string& path) const;
+    static SearchServer LoadSnapshot(const std::string& path, bool verify_checksum = true);
+
 private:
-    std::deque<std::string> storage;
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-    };
     const std::set<std::string, std::less<>> stop_words_;
-    //map(слово, map(документ, частота))
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    //map(документ, map(слово, частота))
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    // Слова документов хранятся один раз в словаре, дальше индекс работает с их номерами
+    TermDictionary dictionary_;
+    //vector(номер слова, отсортированный список внутренних номеров документов с частотами)
+    std::vector<PostingList> word_to_document_freqs_;
+    // Число живых документов со словом; слово без документов удаляется из словаря при уплотнении
+    std::vector<int> document_freqs_;
+    // У сервера из снимка строится при первом обходе (см. BuildDocumentIds)
+    mutable std::set<int> document_ids_;
+
+    // Внешний id документа отображается в плотный внутренний номер (ordinal),
+    // по которому лежат метаданные. Номера удалённых документов переиспользуются после уплотнения.
+    // Метаданные сервера из снимка читаются из файла до первого изменения
+    std::map<int, int> document_to_ordinal_;
+    ExternalArray<int> ordinal_to_document_;
+    ExternalArray<int> ratings_;
+    ExternalArray<DocumentStatus> statuses_;
+    ExternalArray<int> word_counts_;
+    // Отсортированные номера слов документа не из снимка (см. GetDocumentTerms) и их вхождения
+    std::vector<std::vector<TermId>> document_terms_;
+    std::vector<std::vector<uint32_t>> document_term_counts_;
+    bool retain_document_texts_ = false;
+    // Арены словаря, из которых слова перенесены при уплотнении, и их суммарный размер
+    std::vector<TermDictionary::ArenaBlocks> retired_terms_;
+    size_t retired_terms_size_ = 0;
+    std::vector<std::string> document_texts_;
+    std::vector<int> free_ordinals_;
+
+    // Загруженный снимок; списки документов, слова словаря и метаданные указывают в него
+    std::shared_ptr<const Snapshot> snapshot_;
+    // Внутренние номера из снимка: их тексты и прямой индекс лежат в файле
+    size_t snapshot_ordinal_count_ = 0;
+    // Пока индекс из снимка не меняли, пуст. Потом по внутреннему номеру: документ всё ещё в снимке
+    std::vector<char> snapshot_documents_;
+    // Пока индекс из снимка не меняли, id ищутся двоичным поиском по разделу DOCUMENT_ORDINALS,
+    // а document_to_ordinal_ пуст
+    const int* snapshot_document_ordinals_ = nullptr;
+    size_t snapshot_document_count_ = 0;
+    // Словари частот документов, построенные при первом GetWordFrequencies; под word_freqs_mutex
+    mutable std::unordered_map<int, std::map<std::string_view, double>> word_freqs_;
+
+    // Удалённые документы, которые ещё есть в списках слов
+    DocumentBitmap tombstones_;
+    std::vector<int> removed_ordinals_;
+
+    // Поколение индекса: растёт при каждом добавлении и удалении документа
+    uint64_t generation_ = 0;
+    // Кеш и состояние ленивых вычислений держат мьютексы и лежат в куче, чтобы сервер можно было перемещать
+    std::unique_ptr<QueryCache> query_cache_ = std::make_unique<QueryCache>(QUERY_CACHE_DEFAULT_CAPACITY);
+
+    struct TermWeights {
+        double inverse_document_freq = 0.0;
+        // Наибольший вклад слова в релевантность документа
+        double max_score = 0.0;
+    };
+    // IDF по номеру слова после FreezeTermWeights, иначе пуста. Пусто и для слов, у которых
+    // при пересчёте не было документов: их номера могут достаться новым словам
+    std::vector<std::optional<double>> frozen_inverse_document_freqs_;
+    bool term_weights_frozen_ = false;
+    // Индекс менялся после пересчёта таблицы
+    bool term_weights_stale_ = false;
+
+    // Поиск из нескольких потоков достраивает словари частот документов и множество id
+    struct LazyState {
+        std::mutex word_freqs_mutex;
+        std::once_flag document_ids_built;
+    };
+    std::unique_ptr<LazyState> lazy_state_ = std::make_unique<LazyState>();
+
+    void OnIndexChanged();
+
+    explicit SearchServer(std::shared_ptr<const Snapshot> snapshot);
+    // Перед первым изменением индекса из снимка строит document_to_ordinal_ и document_ids_
+    // и заводит таблицы по внутренним номерам; метаданные копируются при первой записи в них
+    void MaterializeSnapshotDocuments();
+    void BuildDocumentIds() const;
+    bool IsSnapshotOrdinal(int ordinal) const;
+    // Документ из снимка перестаёт на него ссылаться: его слова копируются в document_terms_ и document_term_counts_
+    void DetachFromSnapshot(int ordinal);
+    // -1 для неизвестного id
+    int FindOrdinal(int document_id) const;
+    // Для неизвестного id бросает std::out_of_range
+    int GetOrdinal(int document_id) const;
+    IteratorRange<const TermId*> GetDocumentTerms(int ordinal) const;
+    // Вхождения слов документа по порядку GetDocumentTerms
+    std::vector<uint32_t> GetTermCounts(int ordinal) const;
+    std::string_view GetOrdinalText(int ordinal) const;
+    TermWeights GetTermWeights(TermId term_id) const;
+    double ComputeInverseDocumentFreq(TermId term_id) const;
+    void RebuildTermWeights();
+
+    // Список слова, готовый к изменению (сжатый разжимается)
+    PostingList& GetMutablePostings(TermId term_id);
+
+    int AllocateOrdinal(int document_id);
+    void ReleaseOrdinal(int ordinal);
+    // Помечает документ удалённым; номер освобождается при уплотнении
+    void MarkRemoved(int ordinal);
+    // Переносит слова словаря в новую арену и перенаправляет на них ключи word_freqs_
+    void RelocateTerms();
+
+    // Кусок пакета AddDocuments, который разбирает один поток
+    struct IngestChunk {
+        size_t begin = 0;
+        size_t end = 0;
+        // Слова куска в порядке первого появления; индекс — локальный номер слова
+        std::vector<std::string_view> vocabulary;
+        std::vector<TermId> local_to_global;
+        // Слова i-го документа куска — пары (номер слова, вхождения) в [term_begins[i], term_begins[i + 1])
+        // в порядке первого вхождения; после MapIngestChunkTerms номера глобальные и отсортированы
+        std::vector<size_t> term_begins;
+        std::vector<std::pair<TermId, uint32_t>> terms;
+        std::vector<int> word_counts;
+        // Документы с недопустимыми словами (индексы в пакете)
+        std::vector<size_t> invalid;
+    };
 
-    bool IsStopWord(const std::string_view word) const;
+    struct IngestedDocument {
+        int ordinal;
+        const IngestChunk* chunk;
+        size_t position;
+    };
 
-    static bool IsValidWord(const std::string_view word);
+    // Новые документы пакета и их пары (внутренний номер, частота), сгруппированные по словам
+    struct IngestPlan {
+        std::vector<IngestedDocument> documents;
+        std::vector<TermId> terms;
+        std::vector<size_t> term_begins;
+        std::vector<std::pair<int, double>> postings;
+    };
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+    std::vector<char> CheckBatchDocumentIds(const std::vector<DocumentToAdd>& documents,
+        std::vector<AddDocumentError>& errors) const;
+    static std::vector<IngestChunk> MakeIngestChunks(size_t document_count);
+    void TokenizeIngestChunk(const std::vector<DocumentToAdd>& documents, const std::vector<char>& accepted,
+        IngestChunk& chunk) const;
+    // Отбрасывает документы с недопустимыми словами и повторами id внутри пакета,
+    // затем выдаёт номера словам принятых документов в порядке первого вхождения
+    void InternIngestChunks(const std::vector<DocumentToAdd>& documents, std::vector<char>& accepted,
+        std::vector<IngestChunk>& chunks, std::vector<AddDocumentError>& errors);
+    static void MapIngestChunkTerms(const std::vector<char>& accepted, IngestChunk& chunk);
+    IngestPlan PlanIngest(const std::vector<DocumentToAdd>& documents, const std::vector<char>& accepted,
+        const std::vector<IngestChunk>& chunks);
+    void FillDocumentTerms(const IngestedDocument& document);
 
-    static int ComputeAverageRating(const std::vector<int>& ratings);
+    bool IsStopWord(const std::string_view word) const;
+
+    // Слова записываются в буфер words; стоп-слова отбрасываются
+    void SplitIntoWordsNoStop(const std::string_view text, std::vector<std::string_view>& words) const;
 
     struct QueryWord {
         std::string_view data;
@@ -92,26 +363,89 @@ private:
 
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    // Слова запроса, которых нет в словаре, отбрасываются при разборе:
+    // они не могут повлиять на результат
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<TermId> plus_words;
+        std::vector<TermId> minus_words;
     };
 
     Query ParseQuery(const std::string_view text, bool sort = false) const;
 
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
 
+    // Способ поиска для ключа кеша: результаты разных способов не подменяют друг друга
+    static QueryCache::Policy GetCachePolicy(const std::execution::sequenced_policy&) {
+        return QueryCache::Policy::SEQUENCED;
+    }
+    static QueryCache::Policy GetCachePolicy(const std::execution::parallel_policy&) {
+        return QueryCache::Policy::PARALLEL;
+    }
+    static QueryCache::Policy GetCachePolicy(const search_policy::MaxScorePolicy&) {
+        return QueryCache::Policy::MAX_SCORE;
+    }
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsWithStatus(const ExecutionPolicy& policy, const std::string_view raw_query,
+        DocumentStatus status, size_t top_k) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsForQuery(const ExecutionPolicy& policy, const Query& query,
+        DocumentPredicate document_predicate, size_t top_k) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query,
-        DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocumentsForQuery(const std::execution::parallel_policy&, const Query& query,
+        DocumentPredicate document_predicate, size_t top_k) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query,
-        DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocumentsForQuery(const search_policy::MaxScorePolicy&, const Query& query,
+        DocumentPredicate document_predicate, size_t top_k) const;
+
+    // Документы, которые поиск пропускает: удалённые, но ещё не вычищенные (tombstones_ читается
+    // на месте, без копии), и документы минус-слов. Своя битовая карта строится, только если документов
+    // минус-слов много; короткий отсортированный список проверяется двоичным поиском
+    struct ExcludedDocuments {
+        const DocumentBitmap* tombstones = nullptr;
+        DocumentBitmap minus_bitmap;
+        std::vector<int> minus_ordinals;
+
+        bool Test(int ordinal) const {
+            return (tombstones != nullptr && tombstones->Test(ordinal))
+                || (minus_bitmap.empty() ? std::binary_search(minus_ordinals.begin(), minus_ordinals.end(), ordinal)
+                    : minus_bitmap.Test(ordinal));
+        }
+    };
+
+    // Оценивает документы с внутренними номерами из [ordinal_begin, ordinal_end)
+    // и складывает вклады слов в порядке плюс-слов запроса
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query,
-        DocumentPredicate document_predicate) const;
+    TopDocuments FindTopDocumentsInRange(const Query& query, const std::vector<double>& inverse_document_freqs,
+        const ExcludedDocuments& excluded, DocumentPredicate& document_predicate, int ordinal_begin, int ordinal_end, size_t top_k) const;
+
+    // Минус-слова разрешаются до оценки плюс-слов
+    ExcludedDocuments BuildExcludedDocuments(const Query& query) const;
+    // IDF плюс-слов запроса в их порядке
+    std::vector<double> GetInverseDocumentFreqs(const Query& query) const;
+    // Проверка одного документа двоичным поиском по спискам минус-слов
+    bool HasMinusWord(const Query& query, int ordinal) const;
+    // Есть ли общий номер у двух отсортированных наборов слов
+    static bool HasCommonTerm(const std::vector<TermId>& lhs, IteratorRange<const TermId*> rhs);
+
+
+    // Группа запросов пакетного поиска: её слова по возрастанию номеров и для i-го слова —
+    // номера запросов группы, в которых оно есть, в [term_begins[i], term_begins[i + 1]) массива term_queries
+    struct QueryBatchGroup {
+        std::vector<size_t> queries;
+        std::vector<TermId> terms;
+        std::vector<size_t> term_begins;
+        std::vector<uint32_t> term_queries;
+    };
+
+    // Запросы с общим самым длинным списком попадают в одну группу;
+    // вкладов в группе не больше BATCH_SEARCH_MAX_CONTRIBUTIONS
+    std::vector<QueryBatchGroup> PlanQueryBatch(const std::vector<Query>& queries) const;
+    // Складывает вклады слов в релевантность документов в том же порядке, что FindTopDocumentsInRange,
+    // и отбрасывает документы с минус-словами
+    std::vector<Document> CollectBatchDocuments(const Query& query,
+        std::vector<std::pair<int, double>>& contributions) const;
 };
 
 template <typename StringContainer>
@@ -126,56 +460,24 @@ SearchServer::SearchServer(const StringContainer& stop_words)
 
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query,
-    DocumentPredicate document_predicate) const {
+    DocumentPredicate document_predicate, size_t top_k) const {
     const auto query = ParseQuery(raw_query, true);
 
-    auto matched_documents = FindAllDocuments(query, document_predicate);
-
-    sort(matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < MAX_INACCURACY) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-
-    return matched_documents;
+    return FindTopDocumentsForQuery(std::execution::seq, query, document_predicate, top_k);
 }
 
 template <typename DocumentPredicate, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query,
-    DocumentPredicate document_predicate) const {
+    DocumentPredicate document_predicate, size_t top_k) const {
     const auto query = ParseQuery(raw_query, true);
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-
-    sort(policy, matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < MAX_INACCURACY) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-
-    return matched_documents;
+    return FindTopDocumentsForQuery(policy, query, document_predicate, top_k);
 }
 
 template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status) const {
-    return SearchServer::FindTopDocuments(policy,
-        raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status,
+    size_t top_k) const {
+    return FindTopDocumentsWithStatus(policy, raw_query, status, top_k);
 }
 
 template <typename ExecutionPolicy>
@@ -183,102 +485,311 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, c
     return SearchServer::FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsWithStatus(const ExecutionPolicy& policy, const std::string_view raw_query,
+    DocumentStatus status, size_t top_k) const {
+    const auto query = ParseQuery(raw_query, true);
+    QueryCache::Key key{ query.plus_words, query.minus_words, status, top_k, GetCachePolicy(policy) };
+    std::vector<Document> result;
+    if (query_cache_->Find(key, generation_, result)) {
+        return result;
+    }
+    result = FindTopDocumentsForQuery(policy, query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+        }, top_k);
+    query_cache_->Insert(std::move(key), generation_, result);
+    return result;
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsForQuery(const ExecutionPolicy& policy, const Query& query,
+    DocumentPredicate document_predicate, size_t top_k) const {
+    // Весь диапазон внутренних номеров оценивается в буфере потока, так что запрос не строит дерево по документам
+    const ExcludedDocuments excluded = BuildExcludedDocuments(query);
+    return FindTopDocumentsInRange(query, GetInverseDocumentFreqs(query), excluded, document_predicate,
+        0, static_cast<int>(ordinal_to_document_.size()), top_k).Release();
+}
+
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query,
-    DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
+std::vector<Document> SearchServer::FindTopDocumentsForQuery(const search_policy::MaxScorePolicy&, const Query& query,
+    DocumentPredicate document_predicate, size_t top_k) const {
+    struct TermCursor {
+        PostingCursor postings;
+        double inverse_document_freq;
+        double max_score;
+        // Место слова в запросе, то есть по возрастанию номеров слов
+        size_t position;
+
+        bool AtEnd() const {
+            return postings.AtEnd();
+        }
+        int Ordinal() const {
+            return postings.Ordinal();
+        }
+        double Score() const {
+            return postings.TermFreq() * inverse_document_freq;
+        }
+    };
 
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    TopDocuments top(top_k);
+    std::vector<TermCursor> cursors;
+    cursors.reserve(query.plus_words.size());
+    for (const TermId term_id : query.plus_words) {
+        const PostingList& postings = word_to_document_freqs_[term_id];
+        if (document_freqs_[term_id] == 0) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        const TermWeights weights = GetTermWeights(term_id);
+        cursors.push_back({ PostingCursor(postings, word_counts_.data()), weights.inverse_document_freq,
+            weights.max_score, cursors.size() });
+    }
+    if (top_k == 0 || cursors.empty()) {
+        return top.Release();
+    }
+    const ExcludedDocuments excluded = BuildExcludedDocuments(query);
+
+    // Списки упорядочены по возрастанию верхней оценки; max_score_prefix[i] — сумма оценок списков 0..i.
+    // Списки до first_essential вместе не дают документу войти в выдачу,
+    // поэтому кандидаты берутся только из остальных, а по первым лишь досчитывается оценка
+    std::sort(cursors.begin(), cursors.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+        return lhs.max_score < rhs.max_score;
+        });
+    std::vector<double> max_score_prefix(cursors.size());
+    double max_score_sum = 0.0;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        max_score_sum += cursors[i].max_score;
+        max_score_prefix[i] = max_score_sum;
+    }
+
+    // Вклады слов в релевантность кандидата по местам слов в запросе: итоговая сумма складывается
+    // в порядке номеров слов, как при полном переборе, и совпадает с ней до последнего бита
+    std::vector<double> contributions(cursors.size(), 0.0);
+
+    // Документ с оценкой не выше порога не лучше худшего из отобранных даже с учётом MAX_INACCURACY
+    double threshold = -std::numeric_limits<double>::infinity();
+    size_t first_essential = 0;
+    while (first_essential < cursors.size()) {
+        int candidate = std::numeric_limits<int>::max();
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            if (!cursors[i].AtEnd()) {
+                candidate = std::min(candidate, cursors[i].Ordinal());
             }
         }
-    }
+        if (candidate == std::numeric_limits<int>::max()) {
+            break;
+        }
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+        const bool accepted = !excluded.Test(candidate)
+            && document_predicate(ordinal_to_document_[candidate], statuses_[candidate], ratings_[candidate]);
+        std::fill(contributions.begin(), contributions.end(), 0.0);
+        double relevance = 0.0;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            TermCursor& cursor = cursors[i];
+            if (!cursor.AtEnd() && cursor.Ordinal() == candidate) {
+                contributions[cursor.position] = cursor.Score();
+                relevance += contributions[cursor.position];
+                cursor.postings.Next();
+            }
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        if (!accepted) {
+            continue;
         }
-    }
 
+        bool pruned = false;
+        for (size_t i = first_essential; i-- > 0;) {
+            if (relevance + max_score_prefix[i] <= threshold) {
+                pruned = true;
+                break;
+            }
+            TermCursor& cursor = cursors[i];
+            cursor.postings.SeekTo(candidate);
+            if (!cursor.AtEnd() && cursor.Ordinal() == candidate) {
+                contributions[cursor.position] = cursor.Score();
+                relevance += contributions[cursor.position];
+            }
+        }
+        if (pruned) {
+            continue;
+        }
+        relevance = 0.0;
+        for (const double contribution : contributions) {
+            relevance += contribution;
+        }
+        if (relevance <= threshold) {
+            continue;
+        }
 
+        top.Add({ ordinal_to_document_[candidate], relevance, ratings_[candidate] });
+        if (top.IsFull()) {
+            threshold = top.Worst().relevance - MAX_INACCURACY;
+            while (first_essential < cursors.size() && max_score_prefix[first_essential] <= threshold) {
+                ++first_essential;
+            }
+        }
+    }
+    return top.Release();
+}
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-            { document_id, relevance, documents_.at(document_id).rating });
+template <typename DocumentPredicate>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+    DocumentPredicate document_predicate, size_t top_k) const {
+    std::vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (const std::string& raw_query : raw_queries) {
+        queries.push_back(ParseQuery(raw_query, true));
     }
-    return matched_documents;
+    std::vector<std::vector<Document>> results(queries.size());
+    // Пары (документ, вклад слова) каждого запроса группы
+    std::vector<std::vector<std::pair<int, double>>> contributions;
+    for (const QueryBatchGroup& group : PlanQueryBatch(queries)) {
+        contributions.assign(group.queries.size(), {});
+        for (size_t i = 0; i < group.terms.size(); ++i) {
+            const TermId term_id = group.terms[i];
+            const double inverse_document_freq = GetTermWeights(term_id).inverse_document_freq;
+            const uint32_t* const queries_begin = group.term_queries.data() + group.term_begins[i];
+            const uint32_t* const queries_end = group.term_queries.data() + group.term_begins[i + 1];
+            // Предикат и удаление проверяются один раз на документ, а не на каждый запрос
+            for (PostingCursor cursor(word_to_document_freqs_[term_id], word_counts_.data()); !cursor.AtEnd(); cursor.Next()) {
+                const int ordinal = cursor.Ordinal();
+                if (tombstones_.Test(ordinal)
+                    || !document_predicate(ordinal_to_document_[ordinal], statuses_[ordinal], ratings_[ordinal])) {
+                    continue;
+                }
+                const double contribution = cursor.TermFreq() * inverse_document_freq;
+                for (const uint32_t* query = queries_begin; query != queries_end; ++query) {
+                    contributions[*query].emplace_back(ordinal, contribution);
+                }
+            }
+        }
+        for (size_t i = 0; i < group.queries.size(); ++i) {
+            results[group.queries[i]] = SelectTopDocuments(CollectBatchDocuments(queries[group.queries[i]], contributions[i]), top_k);
+        }
+    }
+    return results;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query,
-    DocumentPredicate document_predicate) const {
-    FindAllDocuments(query, document_predicate);
+std::vector<Document> SearchServer::FindTopDocumentsForQuery(const std::execution::parallel_policy&, const Query& query,
+    DocumentPredicate document_predicate, size_t top_k) const {
+    const ExcludedDocuments excluded = BuildExcludedDocuments(query);
+    const std::vector<double> inverse_document_freqs = GetInverseDocumentFreqs(query);
+
+    // Диапазон внутренних номеров делится на куски; каждый поток считает свой кусок
+    // в собственном плотном буфере и отбирает из него лучшие документы, так что блокировок нет
+    const int ordinal_count = static_cast<int>(ordinal_to_document_.size());
+    const int chunk_count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()) * PARALLEL_CHUNKS_PER_THREAD);
+    const int chunk_size = std::max(MIN_PARALLEL_CHUNK_SIZE, (ordinal_count + chunk_count - 1) / chunk_count);
+    std::vector<int> chunk_begins;
+    for (int begin = 0; begin < ordinal_count; begin += chunk_size) {
+        chunk_begins.push_back(begin);
+    }
+
+    return std::transform_reduce(std::execution::par, chunk_begins.begin(), chunk_begins.end(), TopDocuments(top_k),
+        [](TopDocuments lhs, const TopDocuments& rhs) {
+            lhs.Merge(rhs);
+            return lhs;
+        },
+        [&](const int chunk_begin) {
+            return FindTopDocumentsInRange(query, inverse_document_freqs, excluded, document_predicate,
+                chunk_begin, std::min(ordinal_count, chunk_begin + chunk_size), top_k);
+        }).Release();
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query,
-    DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(MAP_BASKET_COUNT);
-
-    std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(),
-        [&document_to_relevance, &document_predicate, this](const std::string_view word) {
-            if (word_to_document_freqs_.count(word)) {
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                    }
-                }
+TopDocuments SearchServer::FindTopDocumentsInRange(const Query& query, const std::vector<double>& inverse_document_freqs,
+    const ExcludedDocuments& excluded, DocumentPredicate& document_predicate, int ordinal_begin, int ordinal_end, size_t top_k) const {
+    using State = ScoreAccumulator::State;
+    // Буферы потока переиспользуются между запросами, поэтому запрос не выделяет память под весь диапазон
+    ScoreAccumulator scores(static_cast<size_t>(ordinal_end - ordinal_begin));
+
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const double inverse_document_freq = inverse_document_freqs[i];
+        PostingCursor cursor(word_to_document_freqs_[query.plus_words[i]], word_counts_.data());
+        for (cursor.SeekTo(ordinal_begin); !cursor.AtEnd() && cursor.Ordinal() < ordinal_end; cursor.Next()) {
+            const int ordinal = cursor.Ordinal();
+            const size_t index = static_cast<size_t>(ordinal - ordinal_begin);
+            State state = scores.GetState(index);
+            if (state == State::UNSEEN) {
+                state = !excluded.Test(ordinal)
+                    && document_predicate(ordinal_to_document_[ordinal], statuses_[ordinal], ratings_[ordinal])
+                    ? State::ACCEPTED : State::REJECTED;
+                scores.SetState(index, state);
             }
-        });
-
-    std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-        [&document_to_relevance, this](const std::string_view word) {
-            if (word_to_document_freqs_.count(word)) {
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance.erase(document_id);
-                }
+            if (state == State::ACCEPTED) {
+                scores.Add(index, cursor.TermFreq() * inverse_document_freq);
             }
-        });
-
+        }
+    }
 
-    auto result = document_to_relevance.BuildOrdinaryMap();
-    std::vector<Document> matched_documents;
-    matched_documents.reserve(result.size());
-    for (const auto [document_id, relevance] : result) {
-        matched_documents.push_back(
-            { document_id, relevance, documents_.at(document_id).rating });
+    // При равной релевантности и рейтинге остаётся документ с меньшим номером, как в MaxScore и пакетном поиске
+    scores.SortSeen();
+    TopDocuments top(top_k);
+    for (const size_t index : scores.GetSeen()) {
+        if (scores.GetState(index) == State::ACCEPTED) {
+            const int ordinal = ordinal_begin + static_cast<int>(index);
+            top.Add({ ordinal_to_document_[ordinal], scores.GetRelevance(index), ratings_[ordinal] });
+        }
     }
-    return matched_documents;
+    return top;
 }
 
 template<typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-
-    if (document_ids_.count(document_id) == 0) {
+    const int ordinal = FindOrdinal(document_id);
+    if (ordinal < 0) {
         throw std::invalid_argument("Invalid document_id.");
     }
 
-    std::vector<std::string> tmp(document_to_word_freqs_[document_id].size());
-    std::transform(policy, document_to_word_freqs_[document_id].cbegin(), document_to_word_freqs_[document_id].cend(),
-        tmp.begin(), [](const auto& word) {return word.first; });
-    for_each(policy, tmp.begin(), tmp.end(), 
-        [this, document_id](const auto& word) {word_to_document_freqs_[word].erase(document_id); });
-
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
-    document_to_word_freqs_.erase(document_id);
+    MaterializeSnapshotDocuments();
+    auto terms = GetDocumentTerms(ordinal);
+    std::for_each(policy, terms.begin(), terms.end(), [this](const TermId term_id) { --document_freqs_[term_id]; });
+    MarkRemoved(ordinal);
+    OnIndexChanged();
+    if (removed_ordinals_.size() * TOMBSTONE_COMPACTION_RATIO > ordinal_to_document_.size()) {
+        CompactIndex();
+    }
 }
 
+template <typename ExecutionPolicy>
+std::vector<AddDocumentError> SearchServer::AddDocuments(ExecutionPolicy&& policy, const std::vector<DocumentToAdd>& documents) {
+    MaterializeSnapshotDocuments();
+    std::vector<AddDocumentError> errors;
+    std::vector<char> accepted = CheckBatchDocumentIds(documents, errors);
+
+    std::vector<IngestChunk> chunks = MakeIngestChunks(documents.size());
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](IngestChunk& chunk) {
+        TokenizeIngestChunk(documents, accepted, chunk);
+        });
+    // Слова получают номера в том же порядке, что и при добавлении документов по одному
+    InternIngestChunks(documents, accepted, chunks, errors);
+    std::for_each(policy, chunks.begin(), chunks.end(), [&accepted](IngestChunk& chunk) {
+        MapIngestChunkTerms(accepted, chunk);
+        });
+
+    IngestPlan plan = PlanIngest(documents, accepted, chunks);
+    std::for_each(policy, plan.documents.begin(), plan.documents.end(), [this](const IngestedDocument& document) {
+        FillDocumentTerms(document);
+        });
+    std::vector<size_t> term_indexes(plan.terms.size());
+    std::iota(term_indexes.begin(), term_indexes.end(), size_t{ 0 });
+    std::for_each(policy, term_indexes.begin(), term_indexes.end(), [this, &plan](const size_t i) {
+        const TermId term_id = plan.terms[i];
+        const auto first = plan.postings.begin() + plan.term_begins[i];
+        const auto last = plan.postings.begin() + plan.term_begins[i + 1];
+        // Освободившиеся внутренние номера выдаются не по возрастанию
+        if (!std::is_sorted(first, last)) {
+            std::sort(first, last);
+        }
+        GetMutablePostings(term_id).InsertSorted(&*first, last - first);
+        document_freqs_[term_id] += static_cast<int>(last - first);
+        });
+
+    if (!plan.documents.empty()) {
+        OnIndexChanged();
+        RefreshTermWeights();
+    }
+    std::sort(errors.begin(), errors.end(), [](const AddDocumentError& lhs, const AddDocumentError& rhs) {
+        return lhs.index < rhs.index;
+        });
+    return errors;
+}
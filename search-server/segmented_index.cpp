@@ -0,0 +1,401 @@
+#include "segmented_index.h"
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <tuple>
+#include <utility>
+using namespace std;
+
+SegmentedIndex::SegmentedIndex(const string& stop_words_text, size_t delta_capacity)
+    : stop_words_(make_shared<const StopWords>(MakeUniqueNonEmptyStrings(SplitIntoWords(stop_words_text))))
+    , delta_capacity_(max<size_t>(delta_capacity, 1))
+    , document_ids_(SEGMENT_DOCUMENT_ID_SHARD_COUNT)
+    , deltas_(SEGMENT_DELTA_SHARD_COUNT) {
+    if (!all_of(stop_words_->begin(), stop_words_->end(), SearchServer::IsValidWord)) {
+        throw invalid_argument("Some of stop words are invalid"s);
+    }
+    PublishView();
+}
+
+SegmentedIndex::~SegmentedIndex() {
+    if (merge_.result.valid()) {
+        merge_.result.wait();
+    }
+}
+
+void SegmentedIndex::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    if (document_id < 0) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    shared_lock update_lock(update_mutex_);
+    {
+        auto access = document_ids_[document_id];
+        if (access.ref_to_value) {
+            throw invalid_argument("Invalid document_id"s);
+        }
+        access.ref_to_value = true;
+    }
+    thread_local vector<string_view> words;
+    if (!SplitIntoValidWords(document, words)) {
+        document_ids_.erase(document_id);
+        throw invalid_argument("Word is invalid"s);
+    }
+    words.erase(remove_if(words.begin(), words.end(), [this](const string_view word) { return stop_words_->count(word) > 0; }),
+        words.end());
+
+    // (слово, позиция): после сортировки первая позиция слова идёт первой в его серии
+    thread_local vector<pair<string_view, size_t>> sorted_words;
+    sorted_words.clear();
+    for (size_t i = 0; i < words.size(); ++i) {
+        sorted_words.emplace_back(words[i], i);
+    }
+    sort(sorted_words.begin(), sorted_words.end());
+    vector<pair<string_view, uint32_t>> term_counts;
+    vector<pair<size_t, string_view>> first_occurrences;
+    for (auto it = sorted_words.begin(); it != sorted_words.end();) {
+        const auto run_end = find_if(it, sorted_words.end(), [word = it->first](const auto& other) { return other.first != word; });
+        term_counts.emplace_back(it->first, static_cast<uint32_t>(run_end - it));
+        first_occurrences.emplace_back(it->second, it->first);
+        it = run_end;
+    }
+    // Новые слова получают номера в порядке первого вхождения, как в SearchServer
+    sort(first_occurrences.begin(), first_occurrences.end());
+    vector<string_view> distinct_words;
+    distinct_words.reserve(first_occurrences.size());
+    for (const auto& [position, word] : first_occurrences) {
+        distinct_words.push_back(word);
+    }
+    terms_.AddDocument(distinct_words);
+
+    unique_ptr<IndexSegment> full_segment;
+    SegmentDeletions full_deleted;
+    {
+        unique_lock<mutex> delta_lock;
+        DeltaShard& delta = LockDeltaShard(delta_lock);
+        delta.segment->AddDocument(document_id, status, SearchServer::ComputeAverageRating(ratings),
+            static_cast<int>(words.size()), term_counts);
+        if (delta.segment->size() >= delta_capacity_) {
+            full_segment = exchange(delta.segment, make_unique<IndexSegment>());
+            full_deleted = exchange(delta.deleted, SegmentDeletions());
+        }
+    }
+    ++document_count_;
+
+    if (full_segment) {
+        // Сжатие идёт без блокировок, параллельно с другими писателями
+        SealedSegment sealed = SealSegment(move(full_segment), move(full_deleted));
+        lock_guard sealed_lock(sealed_mutex_);
+        CompleteMerge(false);
+        sealed_.push_back(move(sealed));
+        PublishView();
+        MaybeStartMerge();
+    }
+    else if (merge_finished_.load()) {
+        unique_lock sealed_lock(sealed_mutex_, try_to_lock);
+        if (sealed_lock) {
+            CompleteMerge(false);
+            MaybeStartMerge();
+        }
+    }
+}
+
+size_t SegmentedIndex::GetSegmentCount() const {
+    lock_guard sealed_lock(sealed_mutex_);
+    return sealed_.size();
+}
+
+void SegmentedIndex::RemoveDocument(int document_id) {
+    lock_guard update_lock(update_mutex_);
+    if (!document_ids_.erase(document_id)) {
+        return;
+    }
+    --document_count_;
+    const auto release_term = [this](string_view term, uint32_t) {
+        terms_.RemoveDocumentTerm(term);
+    };
+
+    bool found = false;
+    for (DeltaShard& delta : deltas_) {
+        const int ordinal = delta.segment->FindOrdinal(document_id, delta.deleted.documents);
+        if (ordinal >= 0) {
+            delta.segment->ForEachTerm(ordinal, release_term);
+            delta.deleted.Add(*delta.segment, ordinal);
+            found = true;
+            break;
+        }
+    }
+    for (auto it = sealed_.begin(); !found && it != sealed_.end(); ++it) {
+        SealedSegment& sealed = *it;
+        const int ordinal = sealed.segment->FindOrdinal(document_id, sealed.deleted->documents);
+        if (ordinal < 0) {
+            continue;
+        }
+        sealed.segment->ForEachTerm(ordinal, release_term);
+        // Представления и слияние могут держать прежние сведения, поэтому они не меняются, а заменяются.
+        // Копия делит с ними куски, поэтому удаление копирует только затронутые
+        auto deleted = make_shared<SegmentDeletions>(*sealed.deleted);
+        deleted->Add(*sealed.segment, ordinal);
+        sealed.deleted = move(deleted);
+        PublishView();
+        found = true;
+    }
+
+    CompleteMerge(false);
+    MaybeStartMerge();
+}
+
+void SegmentedIndex::Flush() {
+    lock_guard update_lock(update_mutex_);
+    CompleteMerge(false);
+    for (DeltaShard& delta : deltas_) {
+        if (delta.segment->size() > 0) {
+            sealed_.push_back(SealSegment(exchange(delta.segment, make_unique<IndexSegment>()),
+                exchange(delta.deleted, SegmentDeletions())));
+        }
+    }
+    PublishView();
+    MaybeStartMerge();
+}
+
+void SegmentedIndex::WaitForMerges() {
+    lock_guard update_lock(update_mutex_);
+    while (merge_.result.valid()) {
+        CompleteMerge(true);
+        MaybeStartMerge();
+    }
+}
+
+SegmentedIndex::DeltaShard& SegmentedIndex::LockDeltaShard(unique_lock<mutex>& lock) {
+    const size_t home = hash<thread::id>{}(this_thread::get_id()) % deltas_.size();
+    // Занятый сегмент пропускается, чтобы писатели не ждали друг друга
+    for (size_t i = 0; i < deltas_.size(); ++i) {
+        DeltaShard& delta = deltas_[(home + i) % deltas_.size()];
+        lock = unique_lock(delta.mutex, try_to_lock);
+        if (lock) {
+            return delta;
+        }
+    }
+    lock = unique_lock(deltas_[home].mutex);
+    return deltas_[home];
+}
+
+SegmentedIndex::SealedSegment SegmentedIndex::SealSegment(unique_ptr<IndexSegment> segment, SegmentDeletions deleted) const {
+    // Все AddDocument этого сегмента уже учли свои слова в terms_, а номера живых слов
+    // не освобождаются, пока нет удалений
+    segment->AssignGlobalTermIds([this](string_view term) { return terms_.Find(term).first; });
+    segment->Seal();
+    deleted.documents.Resize(segment->size());
+    return { shared_ptr<const IndexSegment>(move(segment)), make_shared<const SegmentDeletions>(move(deleted)) };
+}
+
+void SegmentedIndex::PublishView() {
+    auto view = make_shared<View>();
+    view->stop_words_ = stop_words_;
+    view->segments_ = sealed_;
+    for (const SealedSegment& sealed : sealed_) {
+        view->document_count_ += static_cast<int>(sealed.segment->size() - sealed.deleted->count);
+    }
+    atomic_store(&view_, shared_ptr<const View>(move(view)));
+}
+
+void SegmentedIndex::SegmentDeletions::Add(const IndexSegment& segment, int ordinal) {
+    documents.Resize(segment.size());
+    documents.Set(ordinal);
+    term_counts.Resize(max(term_counts.size(), segment.GetTermCount()));
+    segment.ForEachTermId(ordinal, [this](TermId term_id, uint32_t) {
+        ++term_counts.MutableAt(term_id);
+        });
+    ++count;
+}
+
+size_t SegmentedIndex::GetSegmentLevel(const SealedSegment& sealed) const {
+    const size_t live_count = sealed.segment->size() - sealed.deleted->count;
+    size_t level = 0;
+    for (size_t bound = delta_capacity_ * SEGMENT_MERGE_FACTOR; live_count >= bound; bound *= SEGMENT_MERGE_FACTOR) {
+        ++level;
+    }
+    return level;
+}
+
+void SegmentedIndex::MaybeStartMerge() {
+    if (merge_.result.valid()) {
+        return;
+    }
+    size_t first = 0;
+    size_t count = 0;
+    // Сегмент, в котором удалено больше половины документов, переписывается отдельно
+    for (size_t i = 0; i < sealed_.size(); ++i) {
+        if (sealed_[i].deleted->count * 2 > sealed_[i].segment->size()) {
+            first = i;
+            count = 1;
+            break;
+        }
+    }
+    // Иначе сливаются SEGMENT_MERGE_FACTOR подряд идущих сегментов одного уровня, начиная с новых
+    for (size_t end = sealed_.size(); count == 0 && end >= SEGMENT_MERGE_FACTOR; --end) {
+        const size_t level = GetSegmentLevel(sealed_[end - 1]);
+        if (all_of(sealed_.begin() + (end - SEGMENT_MERGE_FACTOR), sealed_.begin() + end,
+            [this, level](const SealedSegment& sealed) { return GetSegmentLevel(sealed) == level; })) {
+            first = end - SEGMENT_MERGE_FACTOR;
+            count = SEGMENT_MERGE_FACTOR;
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+    merge_.first = first;
+    merge_.inputs.assign(sealed_.begin() + first, sealed_.begin() + first + count);
+    // Поток слияния получает свою копию списка сегментов и из общего с индексом меняет только флаг готовности
+    merge_.result = async(launch::async, [this, inputs = merge_.inputs] {
+        shared_ptr<const IndexSegment> merged = MergeSegments(inputs);
+        merge_finished_.store(true);
+        return merged;
+        });
+}
+
+void SegmentedIndex::CompleteMerge(bool wait) {
+    if (!merge_.result.valid() || (!wait && merge_.result.wait_for(chrono::seconds(0)) != future_status::ready)) {
+        return;
+    }
+    const shared_ptr<const IndexSegment> merged = merge_.result.get();
+    merge_finished_.store(false);
+    // Документы, удалённые во время слияния, помечаются и в новом сегменте
+    auto deleted = make_shared<SegmentDeletions>();
+    deleted->documents.Resize(merged->size());
+    for (size_t i = 0; i < merge_.inputs.size(); ++i) {
+        const SealedSegment& input = merge_.inputs[i];
+        const SealedSegment& current = sealed_[merge_.first + i];
+        if (current.deleted->count == input.deleted->count) {
+            continue;
+        }
+        for (int ordinal = 0; ordinal < static_cast<int>(input.segment->size()); ++ordinal) {
+            if (current.deleted->documents.Test(ordinal) && !input.deleted->documents.Test(ordinal)) {
+                deleted->Add(*merged, merged->FindOrdinal(input.segment->GetDocumentId(ordinal), deleted->documents));
+            }
+        }
+    }
+    const auto inputs_begin = sealed_.begin() + merge_.first;
+    sealed_.erase(inputs_begin, inputs_begin + merge_.inputs.size());
+    if (merged->size() > 0) {
+        sealed_.insert(sealed_.begin() + merge_.first, { merged, move(deleted) });
+    }
+    merge_ = Merge();
+    PublishView();
+}
+
+shared_ptr<const IndexSegment> SegmentedIndex::MergeSegments(const vector<SealedSegment>& inputs) {
+    auto merged = make_shared<IndexSegment>();
+    for (const SealedSegment& input : inputs) {
+        merged->AppendDocuments(*input.segment, input.deleted->documents);
+    }
+    merged->Seal();
+    return merged;
+}
+
+void SegmentedIndex::SplitQuery(string_view text, const StopWords& stop_words,
+    vector<string_view>& plus_words, vector<string_view>& minus_words) {
+    thread_local vector<string_view> words;
+    if (!SplitIntoValidWords(text, words)) {
+        throw invalid_argument("Query word is invalid"s);
+    }
+    plus_words.clear();
+    minus_words.clear();
+    for (string_view word : words) {
+        const bool is_minus = word[0] == '-';
+        if (is_minus) {
+            word.remove_prefix(1);
+        }
+        if (word.empty() || word[0] == '-') {
+            throw invalid_argument("Query word is invalid"s);
+        }
+        if (stop_words.count(word) == 0) {
+            (is_minus ? minus_words : plus_words).push_back(word);
+        }
+    }
+    for (vector<string_view>* query_words : { &plus_words, &minus_words }) {
+        sort(query_words->begin(), query_words->end());
+        query_words->erase(unique(query_words->begin(), query_words->end()), query_words->end());
+    }
+}
+
+SegmentedIndex::Query SegmentedIndex::ParseQuery(string_view text) const {
+    Query query;
+    vector<string_view> plus_words;
+    SplitQuery(text, *stop_words_, plus_words, query.minus_words);
+    // (общий номер, число документов, слово)
+    vector<tuple<TermId, int, string_view>> plus_terms;
+    for (const string_view word : plus_words) {
+        const auto [term_id, document_freq] = terms_.Find(word);
+        if (term_id != INVALID_TERM_ID) {
+            plus_terms.emplace_back(term_id, document_freq, word);
+        }
+    }
+    // Вклады слов суммируются по возрастанию общего номера, как в SearchServer
+    sort(plus_terms.begin(), plus_terms.end());
+    const double document_count = GetDocumentCount();
+    for (const auto& [term_id, document_freq, word] : plus_terms) {
+        query.plus_words.push_back(word);
+        query.inverse_document_freqs.push_back(log(document_count * 1.0 / document_freq));
+    }
+    return query;
+}
+
+vector<SegmentedIndex::SearchedSegment> SegmentedIndex::GetSearchedSegments() const {
+    vector<SearchedSegment> segments;
+    segments.reserve(sealed_.size() + deltas_.size());
+    for (const SealedSegment& sealed : sealed_) {
+        segments.push_back({ sealed.segment.get(), &sealed.deleted->documents });
+    }
+    for (const DeltaShard& delta : deltas_) {
+        if (delta.segment->size() > 0) {
+            segments.push_back({ delta.segment.get(), &delta.deleted.documents });
+        }
+    }
+    return segments;
+}
+
+SegmentedIndex::Query SegmentedIndex::View::ParseQuery(string_view text) const {
+    Query query;
+    vector<string_view> plus_words;
+    SplitQuery(text, *stop_words_, plus_words, query.minus_words);
+    // (общий номер, число документов, слово)
+    vector<tuple<TermId, int, string_view>> plus_terms;
+    for (const string_view word : plus_words) {
+        TermId global_term_id = INVALID_TERM_ID;
+        int document_freq = 0;
+        for (const SealedSegment& sealed : segments_) {
+            const TermId term_id = sealed.segment->FindTerm(word);
+            if (term_id == INVALID_TERM_ID) {
+                continue;
+            }
+            const auto& deleted_counts = sealed.deleted->term_counts;
+            const int live_count = static_cast<int>(sealed.segment->GetPostings(term_id).size())
+                - (term_id < deleted_counts.size() ? deleted_counts[term_id] : 0);
+            if (live_count > 0) {
+                // Номер слова не освобождается, пока у него есть живые документы, поэтому у таких сегментов он один
+                global_term_id = sealed.segment->GetGlobalTermId(term_id);
+                document_freq += live_count;
+            }
+        }
+        if (document_freq > 0) {
+            plus_terms.emplace_back(global_term_id, document_freq, word);
+        }
+    }
+    // Вклады слов суммируются по возрастанию общего номера, как в SearchServer
+    sort(plus_terms.begin(), plus_terms.end());
+    const double document_count = document_count_;
+    for (const auto& [term_id, document_freq, word] : plus_terms) {
+        query.plus_words.push_back(word);
+        query.inverse_document_freqs.push_back(log(document_count * 1.0 / document_freq));
+    }
+    return query;
+}
+
+vector<SegmentedIndex::SearchedSegment> SegmentedIndex::View::GetSearchedSegments() const {
+    vector<SearchedSegment> segments;
+    segments.reserve(segments_.size());
+    for (const SealedSegment& sealed : segments_) {
+        segments.push_back({ sealed.segment.get(), &sealed.deleted->documents });
+    }
+    return segments;
+}
@@ -0,0 +1,304 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <execution>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "chunked_array.h"
+#include "concurrent_map.h"
+#include "document.h"
+#include "index_segment.h"
+#include "score_accumulator.h"
+#include "search_server.h"
+#include "sharded_term_dictionary.h"
+#include "string_processing.h"
+#include "top_documents.h"
+
+// Документов в изменяемом сегменте, после которых он запечатывается
+constexpr size_t SEGMENT_DEFAULT_DELTA_CAPACITY = 4096;
+// Сколько сегментов одного уровня сливаются в один
+constexpr size_t SEGMENT_MERGE_FACTOR = 4;
+// Изменяемых сегментов: параллельные AddDocument пишут в разные
+constexpr size_t SEGMENT_DELTA_SHARD_COUNT = 16;
+// Шардов в таблице зарегистрированных id
+constexpr size_t SEGMENT_DOCUMENT_ID_SHARD_COUNT = 64;
+
+// Индекс из сегментов в духе LSM: новые документы попадают в небольшой изменяемый сегмент
+// (у каждого пишущего потока обычно свой), который по заполнении запечатывается в неизменяемый сжатый сегмент. Фоновое слияние объединяет
+// сегменты одного уровня и выбрасывает удалённые документы. Поиск обходит все сегменты,
+// IDF считается по общей статистике, поэтому релевантность та же, что у SearchServer
+// с теми же документами. Запечатанные сегменты не меняются и читаются без блокировок:
+// удаление заменяет сведения об удалённых документах сегмента новой копией, которая разделяет
+// с прежней все куски, кроме изменённых.
+// AddDocument можно вызывать из многих потоков одновременно; остальные изменяющие методы
+// дожидаются идущих AddDocument и выполняются одни. Как и SearchServer, индекс допускает параллельный поиск,
+// но не поиск во время изменения. Для поиска во время изменения индекс публикует неизменяемые представления (GetView)
+class SegmentedIndex {
+public:
+    using StopWords = std::set<std::string, std::less<>>;
+
+    class View;
+
+    explicit SegmentedIndex(const std::string& stop_words_text, size_t delta_capacity = SEGMENT_DEFAULT_DELTA_CAPACITY);
+    ~SegmentedIndex();
+
+    SegmentedIndex(const SegmentedIndex&) = delete;
+    SegmentedIndex& operator=(const SegmentedIndex&) = delete;
+
+    // Ошибки те же, что у SearchServer::AddDocument. Потокобезопасен: из двух параллельных
+    // вызовов с одним id успешен ровно один
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // Неизвестный id пропускается
+    void RemoveDocument(int document_id);
+
+    // Запечатывает изменяемые сегменты, не дожидаясь их заполнения
+    void Flush();
+    // Дожидается фоновых слияний, включая те, что понадобятся после уже идущих
+    void WaitForMerges();
+
+    int GetDocumentCount() const {
+        return document_count_.load();
+    }
+
+    // Запечатанных сегментов; можно вызывать во время AddDocument
+    size_t GetSegmentCount() const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+        DocumentPredicate document_predicate, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(policy, raw_query, [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+            }, top_k);
+    }
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(std::execution::seq, raw_query, status, top_k);
+    }
+
+    // Последнее опубликованное представление. Единственный метод, который можно вызывать
+    // из любых потоков во время изменения индекса; читатель не ждёт писателя дольше копирования указателя
+    std::shared_ptr<const View> GetView() const {
+        return std::atomic_load(&view_);
+    }
+
+private:
+    // Удалённые документы сегмента
+    struct SegmentDeletions {
+        ChunkedBitmap documents;
+        // Удалённых документов с каждым словом, по номеру слова в сегменте
+        ChunkedArray<int, 256> term_counts;
+        size_t count = 0;
+
+        void Add(const IndexSegment& segment, int ordinal);
+    };
+
+    struct SealedSegment {
+        std::shared_ptr<const IndexSegment> segment;
+        // Не меняются после публикации: удаление заменяет их копией с общими неизменёнными кусками
+        std::shared_ptr<const SegmentDeletions> deleted;
+    };
+
+    // Слияние сегментов sealed_[first, first + inputs.size()), идущее в фоне
+    struct Merge {
+        size_t first = 0;
+        std::vector<SealedSegment> inputs;
+        std::future<std::shared_ptr<const IndexSegment>> result;
+    };
+
+    // Сегмент, по которому идёт поиск
+    struct SearchedSegment {
+        const IndexSegment* segment;
+        const ChunkedBitmap* deleted;
+    };
+
+    // Слова запроса: плюс-слова по возрастанию общего номера (в том же порядке,
+    // что и в SearchServer, суммируются вклады слов) и их IDF
+    struct Query {
+        std::vector<std::string_view> plus_words;
+        std::vector<double> inverse_document_freqs;
+        std::vector<std::string_view> minus_words;
+    };
+
+    // Общие с представлениями, которые могут пережить индекс
+    const std::shared_ptr<const StopWords> stop_words_;
+    const size_t delta_capacity_;
+
+    struct alignas(CACHE_LINE_SIZE) DeltaShard {
+        std::mutex mutex;
+        std::unique_ptr<IndexSegment> segment = std::make_unique<IndexSegment>();
+        SegmentDeletions deleted;
+    };
+
+    // AddDocument держит его на чтение, остальные изменяющие методы — на запись
+    std::shared_mutex update_mutex_;
+
+    // Общие для всех сегментов слова и число живых документов с ними
+    ShardedTermDictionary terms_;
+    // Значение true у зарегистрированного id
+    ConcurrentMap<int, bool> document_ids_;
+    std::atomic<int> document_count_ = 0;
+
+    std::vector<DeltaShard> deltas_;
+    // Защищает sealed_, merge_ и публикацию представлений от параллельных AddDocument
+    mutable std::mutex sealed_mutex_;
+    std::vector<SealedSegment> sealed_;
+    Merge merge_;
+    // Поток слияния отмечает, что результат готов, чтобы AddDocument не проверял future каждый раз
+    std::atomic<bool> merge_finished_ = false;
+    // Читается и заменяется только через std::atomic_load и std::atomic_store
+    std::shared_ptr<const View> view_;
+
+    // Блокирует свободный изменяемый сегмент, начиная с закреплённого за потоком, и возвращает его
+    DeltaShard& LockDeltaShard(std::unique_lock<std::mutex>& lock);
+    // Запоминает в сегменте общие номера слов и запечатывает его. Вызывается, пока удаления невозможны
+    SealedSegment SealSegment(std::unique_ptr<IndexSegment> segment, SegmentDeletions deleted) const;
+    // Публикует представление из текущих запечатанных сегментов
+    void PublishView();
+    // Устанавливает готовое слияние; wait — дождаться идущего
+    void CompleteMerge(bool wait);
+    void MaybeStartMerge();
+    static std::shared_ptr<const IndexSegment> MergeSegments(const std::vector<SealedSegment>& inputs);
+    size_t GetSegmentLevel(const SealedSegment& sealed) const;
+
+    // Разбирает запрос на различные плюс- и минус-слова без стоп-слов
+    static void SplitQuery(std::string_view text, const StopWords& stop_words,
+        std::vector<std::string_view>& plus_words, std::vector<std::string_view>& minus_words);
+    Query ParseQuery(std::string_view text) const;
+    std::vector<SearchedSegment> GetSearchedSegments() const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    static std::vector<Document> FindTopDocumentsInSegments(ExecutionPolicy&& policy, const std::vector<SearchedSegment>& segments,
+        const Query& query, DocumentPredicate& document_predicate, size_t top_k);
+
+    template <typename DocumentPredicate>
+    static TopDocuments FindTopDocumentsInSegment(const SearchedSegment& searched, const Query& query,
+        DocumentPredicate& document_predicate, size_t top_k);
+};
+
+// Неизменяемый индекс из запечатанных сегментов на момент публикации. Документы попадают в представление,
+// когда изменяемый сегмент запечатывается (по заполнении или при Flush), удаления — сразу.
+// Представление ничего не разделяет с изменяемой частью индекса и живёт, пока на него есть ссылка,
+// в том числе после разрушения индекса; сегменты, на которые больше никто не ссылается, освобождаются
+class SegmentedIndex::View {
+public:
+    int GetDocumentCount() const {
+        return document_count_;
+    }
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+        DocumentPredicate document_predicate, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const {
+        const Query query = ParseQuery(raw_query);
+        return FindTopDocumentsInSegments(policy, GetSearchedSegments(), query, document_predicate, top_k);
+    }
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(policy, raw_query, [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+            }, top_k);
+    }
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const {
+        return FindTopDocuments(std::execution::seq, raw_query, status, top_k);
+    }
+
+private:
+    friend class SegmentedIndex;
+
+    std::shared_ptr<const StopWords> stop_words_;
+    std::vector<SealedSegment> segments_;
+    int document_count_ = 0;
+
+    // Число документов со словом считается по сегментам представления, а общий номер слова
+    // берётся из сегмента, где у слова есть живые документы
+    Query ParseQuery(std::string_view text) const;
+    std::vector<SearchedSegment> GetSearchedSegments() const;
+};
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SegmentedIndex::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t top_k) const {
+    const Query query = ParseQuery(raw_query);
+    return FindTopDocumentsInSegments(policy, GetSearchedSegments(), query, document_predicate, top_k);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SegmentedIndex::FindTopDocumentsInSegments(ExecutionPolicy&& policy,
+    const std::vector<SearchedSegment>& segments, const Query& query, DocumentPredicate& document_predicate, size_t top_k) {
+    return std::transform_reduce(policy, segments.begin(), segments.end(), TopDocuments(top_k),
+        [](TopDocuments lhs, const TopDocuments& rhs) {
+            lhs.Merge(rhs);
+            return lhs;
+        },
+        [&](const SearchedSegment& searched) {
+            return FindTopDocumentsInSegment(searched, query, document_predicate, top_k);
+        }).Release();
+}
+
+template <typename DocumentPredicate>
+TopDocuments SegmentedIndex::FindTopDocumentsInSegment(const SearchedSegment& searched, const Query& query,
+    DocumentPredicate& document_predicate, size_t top_k) {
+    using State = ScoreAccumulator::State;
+    const IndexSegment& segment = *searched.segment;
+    // Буферы потока переиспользуются между запросами и сегментами. Документы минус-слов сразу
+    // отвергаются в них же, удалённые проверяются по общей карте сегмента, поэтому своих карт нет
+    ScoreAccumulator scores(segment.size());
+    for (const std::string_view word : query.minus_words) {
+        const TermId term_id = segment.FindTerm(word);
+        if (term_id == INVALID_TERM_ID) {
+            continue;
+        }
+        for (PostingCursor cursor(segment.GetPostings(term_id), segment.GetWordCounts()); !cursor.AtEnd(); cursor.Next()) {
+            if (scores.GetState(cursor.Ordinal()) == State::UNSEEN) {
+                scores.SetState(cursor.Ordinal(), State::REJECTED);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const TermId term_id = segment.FindTerm(query.plus_words[i]);
+        if (term_id == INVALID_TERM_ID) {
+            continue;
+        }
+        const double inverse_document_freq = query.inverse_document_freqs[i];
+        for (PostingCursor cursor(segment.GetPostings(term_id), segment.GetWordCounts()); !cursor.AtEnd(); cursor.Next()) {
+            const int ordinal = cursor.Ordinal();
+            State state = scores.GetState(ordinal);
+            if (state == State::UNSEEN) {
+                state = !searched.deleted->Test(ordinal)
+                    && document_predicate(segment.GetDocumentId(ordinal), segment.GetStatus(ordinal), segment.GetRating(ordinal))
+                    ? State::ACCEPTED : State::REJECTED;
+                scores.SetState(ordinal, state);
+            }
+            if (state == State::ACCEPTED) {
+                scores.Add(ordinal, cursor.TermFreq() * inverse_document_freq);
+            }
+        }
+    }
+
+    TopDocuments top(top_k);
+    for (const size_t index : scores.GetSeen()) {
+        if (scores.GetState(index) == State::ACCEPTED) {
+            const int ordinal = static_cast<int>(index);
+            top.Add({ segment.GetDocumentId(ordinal), scores.GetRelevance(index), segment.GetRating(ordinal) });
+        }
+    }
+    return top;
+}
@@ -0,0 +1,97 @@
+#include "sharded_term_dictionary.h"
+#include <algorithm>
+#include <functional>
+#include <tuple>
+using namespace std;
+
+ShardedTermDictionary::ShardedTermDictionary(size_t shard_count)
+    : shards_(max<size_t>(shard_count, 1)) {
+}
+
+void ShardedTermDictionary::AddDocument(const vector<string_view>& terms) {
+    // (шард, позиция слова в terms)
+    thread_local vector<pair<size_t, size_t>> sharded_terms;
+    // (позиция нового слова в terms, шард, номер в шарде)
+    thread_local vector<tuple<size_t, size_t, TermId>> new_terms;
+    sharded_terms.clear();
+    new_terms.clear();
+    for (size_t i = 0; i < terms.size(); ++i) {
+        sharded_terms.emplace_back(ShardIndexOf(terms[i]), i);
+    }
+    sort(sharded_terms.begin(), sharded_terms.end());
+    for (auto it = sharded_terms.begin(); it != sharded_terms.end();) {
+        const size_t shard_index = it->first;
+        Shard& shard = shards_[shard_index];
+        lock_guard guard(shard.mutex);
+        for (; it != sharded_terms.end() && it->first == shard_index; ++it) {
+            const TermId local_id = shard.terms.Intern(terms[it->second]);
+            if (local_id >= shard.term_ids.size()) {
+                shard.term_ids.resize(local_id + 1, INVALID_TERM_ID);
+                shard.document_freqs.resize(local_id + 1);
+            }
+            if (shard.document_freqs[local_id]++ == 0) {
+                new_terms.emplace_back(it->second, shard_index, local_id);
+            }
+        }
+    }
+    if (new_terms.empty()) {
+        return;
+    }
+    // Номера новым словам выдаются в порядке terms, как при последовательном TermDictionary::Intern
+    sort(new_terms.begin(), new_terms.end());
+    vector<TermId> term_ids(new_terms.size());
+    {
+        lock_guard guard(term_ids_mutex_);
+        for (TermId& term_id : term_ids) {
+            if (free_term_ids_.empty()) {
+                term_id = next_term_id_++;
+            }
+            else {
+                term_id = free_term_ids_.back();
+                free_term_ids_.pop_back();
+            }
+        }
+    }
+    for (size_t i = 0; i < new_terms.size(); ++i) {
+        const auto [position, shard_index, local_id] = new_terms[i];
+        Shard& shard = shards_[shard_index];
+        lock_guard guard(shard.mutex);
+        shard.term_ids[local_id] = term_ids[i];
+    }
+}
+
+void ShardedTermDictionary::RemoveDocumentTerm(string_view term) {
+    Shard& shard = shards_[ShardIndexOf(term)];
+    lock_guard guard(shard.mutex);
+    const TermId local_id = shard.terms.Find(term);
+    if (local_id == INVALID_TERM_ID || --shard.document_freqs[local_id] > 0) {
+        return;
+    }
+    ReleaseTermId(shard.term_ids[local_id]);
+    shard.term_ids[local_id] = INVALID_TERM_ID;
+    shard.terms.Erase(local_id);
+    if (shard.terms.NeedsCompaction()) {
+        // Представления слов словаря наружу не отдаются
+        [[maybe_unused]] const TermDictionary::ArenaBlocks old_blocks = shard.terms.CompactArena();
+    }
+}
+
+pair<TermId, int> ShardedTermDictionary::Find(string_view term) const {
+    const Shard& shard = shards_[ShardIndexOf(term)];
+    lock_guard guard(shard.mutex);
+    const TermId local_id = shard.terms.Find(term);
+    if (local_id == INVALID_TERM_ID) {
+        return { INVALID_TERM_ID, 0 };
+    }
+    return { shard.term_ids[local_id], shard.document_freqs[local_id] };
+}
+
+size_t ShardedTermDictionary::ShardIndexOf(string_view term) const {
+    // Младшие биты хеша выбирают ячейку внутри TermDictionary, поэтому шард выбирается старшими
+    return (static_cast<uint64_t>(hash<string_view>{}(term)) >> 32) % shards_.size();
+}
+
+void ShardedTermDictionary::ReleaseTermId(TermId term_id) {
+    lock_guard guard(term_ids_mutex_);
+    free_term_ids_.push_back(term_id);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "concurrent_map.h"
+#include "term_dictionary.h"
+
+// Шардов в ShardedTermDictionary по умолчанию
+constexpr size_t TERM_DICTIONARY_DEFAULT_SHARD_COUNT = 64;
+
+// Слова индекса и число документов с каждым из них, разбитые на шарды по хешу слова:
+// у каждого шарда свой TermDictionary и свой мьютекс, поэтому документы со словами
+// из разных шардов учитываются параллельно. Номера слов общие для всех шардов и выдаются
+// так же, как в TermDictionary: новое слово получает последний освобождённый номер.
+// Общий мьютекс номеров берётся только при появлении и исчезновении слова
+class ShardedTermDictionary {
+public:
+    explicit ShardedTermDictionary(size_t shard_count = TERM_DICTIONARY_DEFAULT_SHARD_COUNT);
+
+    ShardedTermDictionary(const ShardedTermDictionary&) = delete;
+    ShardedTermDictionary& operator=(const ShardedTermDictionary&) = delete;
+
+    // Учитывает документ с различными словами terms: каждый шард блокируется один раз.
+    // Новые слова получают номера в порядке terms
+    void AddDocument(const std::vector<std::string_view>& terms);
+
+    // Уменьшает число документов со словом; слово с нулём документов удаляется
+    void RemoveDocumentTerm(std::string_view term);
+
+    // Общий номер слова и число документов с ним; { INVALID_TERM_ID, 0 }, если слова нет
+    std::pair<TermId, int> Find(std::string_view term) const;
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        mutable std::mutex mutex;
+        TermDictionary terms;
+        // По номеру слова в шарде. Новое слово получает общий номер чуть позже, чем попадает в шард:
+        // Find может вернуть INVALID_TERM_ID при ненулевом числе документов, пока идёт AddDocument
+        std::vector<TermId> term_ids;
+        std::vector<int> document_freqs;
+    };
+
+    std::vector<Shard> shards_;
+    std::mutex term_ids_mutex_;
+    TermId next_term_id_ = 0;
+    std::vector<TermId> free_term_ids_;
+
+    size_t ShardIndexOf(std::string_view term) const;
+    void ReleaseTermId(TermId term_id);
+};
@@ -0,0 +1,129 @@
+#include "snapshot.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+using namespace std;
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = { 'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P' };
+// Снимок, записанный на машине с другим порядком байт, не совпадёт по этому полю
+constexpr uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    uint64_t checksum;
+    SnapshotRange sections[static_cast<size_t>(SnapshotSection::COUNT)];
+};
+
+static_assert(sizeof(SnapshotHeader) % 8 == 0, "sections must stay 8-byte aligned");
+
+constexpr uint64_t CHECKSUM_SEED = 14695981039346656037ull;
+
+uint64_t AlignUp(uint64_t value) {
+    return (value + 7) & ~uint64_t{ 7 };
+}
+
+// FNV-1a по 8-байтовым словам; неполное последнее слово дополняется нулями,
+// как и раздел в файле, поэтому сумма по разделам равна сумме по всему файлу
+uint64_t UpdateChecksum(uint64_t checksum, const char* data, size_t size) {
+    uint64_t word;
+    for (; size >= sizeof(word); data += sizeof(word), size -= sizeof(word)) {
+        memcpy(&word, data, sizeof(word));
+        checksum = (checksum ^ word) * 1099511628211ull;
+    }
+    if (size > 0) {
+        word = 0;
+        memcpy(&word, data, size);
+        checksum = (checksum ^ word) * 1099511628211ull;
+    }
+    return checksum;
+}
+
+}  // namespace
+
+SnapshotWriter::SnapshotWriter(const string& path)
+    : path_(path)
+    , temp_path_(path + ".tmp"s)
+    , out_(temp_path_, ios::binary | ios::trunc)
+    , position_(sizeof(SnapshotHeader))
+    , checksum_(CHECKSUM_SEED) {
+    const SnapshotHeader placeholder{};
+    out_.write(reinterpret_cast<const char*>(&placeholder), sizeof(placeholder));
+    if (!out_) {
+        throw runtime_error("Cannot write "s + temp_path_);
+    }
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (!finished_) {
+        out_.close();
+        remove(temp_path_.c_str());
+    }
+}
+
+void SnapshotWriter::Write(SnapshotSection section, const void* data, size_t size) {
+    static const char padding[8] = {};
+    const uint64_t padded_size = AlignUp(size);
+    sections_[static_cast<size_t>(section)] = { position_, size };
+    out_.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+    out_.write(padding, static_cast<streamsize>(padded_size - size));
+    checksum_ = UpdateChecksum(checksum_, static_cast<const char*>(data), size);
+    position_ += padded_size;
+}
+
+void SnapshotWriter::Finish() {
+    SnapshotHeader header{};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.file_size = position_;
+    header.checksum = checksum_;
+    copy(begin(sections_), end(sections_), header.sections);
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.close();
+    if (!out_) {
+        throw runtime_error("Cannot write "s + temp_path_);
+    }
+    ReplaceFileDurably(temp_path_, path_);
+    finished_ = true;
+}
+
+Snapshot::Snapshot(const string& path, bool verify_checksum)
+    : file_(path) {
+    if (file_.size() < sizeof(SnapshotHeader)) {
+        throw runtime_error("Snapshot is corrupted"s);
+    }
+    SnapshotHeader header;
+    memcpy(&header, file_.data(), sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.byte_order != SNAPSHOT_BYTE_ORDER) {
+        throw runtime_error("Not a snapshot: "s + path);
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw runtime_error("Unsupported snapshot version "s + to_string(header.version));
+    }
+    if (header.file_size != file_.size()) {
+        throw runtime_error("Snapshot is corrupted"s);
+    }
+    for (const SnapshotRange& range : header.sections) {
+        if (range.offset % 8 != 0 || range.offset > file_.size() || range.size > file_.size() - range.offset) {
+            throw runtime_error("Snapshot is corrupted"s);
+        }
+    }
+    if (verify_checksum
+        && UpdateChecksum(CHECKSUM_SEED, file_.data() + sizeof(header), file_.size() - sizeof(header)) != header.checksum) {
+        throw runtime_error("Snapshot checksum mismatch"s);
+    }
+    copy(begin(header.sections), end(header.sections), sections_);
+}
+
+bool Snapshot::HasValidOffsets(SnapshotSection offsets, uint64_t limit) const {
+    const size_t count = Count<uint64_t>(offsets);
+    const uint64_t* values = Data<uint64_t>(offsets);
+    return count > 0 && is_sorted(values, values + count) && values[count - 1] <= limit;
+}
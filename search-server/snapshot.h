@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mapped_file.h"
+
+// Снимки других версий не загружаются
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+// Разделы снимка индекса. Раздел — массив чисел в порядке байт машины, записавшей снимок;
+// разделы выровнены на 8 байт, поэтому массивы читаются прямо из отображённого файла
+enum class SnapshotSection : uint32_t {
+    SETTINGS,
+    STOP_WORD_OFFSETS,
+    STOP_WORD_BYTES,
+    // Слова словаря: смещения в TERM_BYTES по номерам слов, освобождённые номера пусты
+    TERM_OFFSETS,
+    TERM_BYTES,
+    FREE_TERM_IDS,
+    // Сжатые списки документов по номерам слов: блоки и данные Stream VByte
+    DOCUMENT_FREQS,
+    MAX_TERM_FREQS,
+    POSTING_SIZES,
+    BLOCK_OFFSETS,
+    BLOCKS,
+    POSTING_DATA_OFFSETS,
+    POSTING_DATA,
+    // Данные по внутренним номерам документов
+    ORDINAL_TO_DOCUMENT,
+    // Внутренние номера живых документов по возрастанию id: по ним id ищутся без построения словаря
+    DOCUMENT_ORDINALS,
+    RATINGS,
+    STATUSES,
+    WORD_COUNTS,
+    // Прямой индекс: слова документа по возрастанию номера и число их вхождений
+    FORWARD_OFFSETS,
+    FORWARD_TERMS,
+    FORWARD_COUNTS,
+    FREE_ORDINALS,
+    REMOVED_ORDINALS,
+    TEXT_OFFSETS,
+    TEXT_BYTES,
+    COUNT
+};
+
+struct SnapshotRange {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+// Пишет разделы снимка во временный файл рядом с path, затем заголовок с оглавлением и контрольной суммой.
+// Finish подменяет им path, поэтому старый снимок, в том числе отображённый в память, не портится.
+// Ошибки записи — std::runtime_error
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+    // Незавершённый временный файл удаляется
+    ~SnapshotWriter();
+
+    template <typename T>
+    void Write(SnapshotSection section, const std::vector<T>& values) {
+        Write(section, values.data(), values.size() * sizeof(T));
+    }
+
+    void Write(SnapshotSection section, const void* data, size_t size);
+
+    void Finish();
+
+private:
+    std::string path_;
+    std::string temp_path_;
+    std::ofstream out_;
+    SnapshotRange sections_[static_cast<size_t>(SnapshotSection::COUNT)];
+    uint64_t position_;
+    uint64_t checksum_;
+    bool finished_ = false;
+};
+
+// Отображённый в память снимок. При открытии проверяются версия, оглавление и контрольная сумма
+// (std::runtime_error при несовпадении); данные разделов не копируются. Контрольная сумма читает файл
+// целиком; без неё (verify_checksum = false) повреждение внутри сжатых списков не обнаруживается
+class Snapshot {
+public:
+    explicit Snapshot(const std::string& path, bool verify_checksum = true);
+
+    template <typename T>
+    const T* Data(SnapshotSection section) const {
+        return reinterpret_cast<const T*>(file_.data() + sections_[static_cast<size_t>(section)].offset);
+    }
+
+    template <typename T>
+    size_t Count(SnapshotSection section) const {
+        return sections_[static_cast<size_t>(section)].size / sizeof(T);
+    }
+
+    // Раздел offsets (uint64_t) не пуст, не убывает и не выходит за limit: по нему можно брать подмассивы
+    bool HasValidOffsets(SnapshotSection offsets, uint64_t limit) const;
+
+    // index-я строка таблицы: границы в разделе offsets (uint64_t), байты в разделе bytes
+    std::string_view GetString(SnapshotSection offsets, SnapshotSection bytes, size_t index) const {
+        const uint64_t* bounds = Data<uint64_t>(offsets);
+        return std::string_view(Data<char>(bytes) + bounds[index], bounds[index + 1] - bounds[index]);
+    }
+
+private:
+    MappedFile file_;
+    SnapshotRange sections_[static_cast<size_t>(SnapshotSection::COUNT)];
+};
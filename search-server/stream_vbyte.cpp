@@ -0,0 +1,171 @@
+#include "stream_vbyte.h"
+#include <cstring>
+
+// SIMD-декодер собирается для x86 всегда, а вызывается, только если процессор поддерживает SSSE3:
+// сборка без -mssse3 получает ускорение, а бинарник не падает на процессорах без SSSE3
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STREAM_VBYTE_SIMD 1
+#define STREAM_VBYTE_TARGET_SSSE3 __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+#define STREAM_VBYTE_SIMD 1
+#define STREAM_VBYTE_TARGET_SSSE3
+#include <intrin.h>
+#include <tmmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+size_t EncodedLength(uint32_t value) {
+    if (value < (1u << 8)) {
+        return 1;
+    }
+    if (value < (1u << 16)) {
+        return 2;
+    }
+    if (value < (1u << 24)) {
+        return 3;
+    }
+    return 4;
+}
+
+uint32_t ReadValue(const uint8_t* in, size_t length) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < length; ++i) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+#ifdef STREAM_VBYTE_SIMD
+
+// Для каждого управляющего байта: маска перестановки байт данных в четыре uint32 и общая длина
+struct DecodeTables {
+    alignas(16) uint8_t shuffles[256][16];
+    uint8_t lengths[256];
+
+    DecodeTables() {
+        for (int control = 0; control < 256; ++control) {
+            uint8_t offset = 0;
+            for (int value = 0; value < 4; ++value) {
+                const int length = ((control >> (2 * value)) & 3) + 1;
+                for (int byte = 0; byte < 4; ++byte) {
+                    shuffles[control][4 * value + byte] = byte < length ? static_cast<uint8_t>(offset + byte) : 0x80;
+                }
+                offset = static_cast<uint8_t>(offset + length);
+            }
+            lengths[control] = offset;
+        }
+    }
+};
+
+const DecodeTables& GetDecodeTables() {
+    static const DecodeTables tables;
+    return tables;
+}
+
+bool CpuHasSsse3() {
+#if defined(__GNUC__)
+    return __builtin_cpu_supports("ssse3");
+#else
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#endif
+}
+
+template <bool Delta>
+STREAM_VBYTE_TARGET_SSSE3 const uint8_t* DecodeSimd(const uint8_t* in, size_t count, uint32_t previous, uint32_t* values) {
+    const DecodeTables& tables = GetDecodeTables();
+    const uint8_t* controls = in;
+    const uint8_t* data = in + count / 4;
+    __m128i last = _mm_set1_epi32(static_cast<int>(previous));
+    for (size_t group = 0; group < count / 4; ++group) {
+        const uint8_t control = controls[group];
+        __m128i decoded = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)),
+            _mm_load_si128(reinterpret_cast<const __m128i*>(tables.shuffles[control])));
+        if (Delta) {
+            // Префиксная сумма внутри четвёрки плюс последнее число предыдущей
+            decoded = _mm_add_epi32(decoded, _mm_slli_si128(decoded, 4));
+            decoded = _mm_add_epi32(decoded, _mm_slli_si128(decoded, 8));
+            decoded = _mm_add_epi32(decoded, last);
+            last = _mm_shuffle_epi32(decoded, 0xFF);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + 4 * group), decoded);
+        data += tables.lengths[control];
+    }
+    return data;
+}
+
+#endif
+
+}  // namespace
+
+void StreamVByteEncode(const uint32_t* values, size_t count, vector<uint8_t>& out) {
+    const size_t controls_begin = out.size();
+    out.resize(controls_begin + count / 4, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t length = EncodedLength(values[i]);
+        out[controls_begin + i / 4] |= static_cast<uint8_t>((length - 1) << (2 * (i % 4)));
+        for (size_t byte = 0; byte < length; ++byte) {
+            out.push_back(static_cast<uint8_t>(values[i] >> (8 * byte)));
+        }
+    }
+}
+
+void StreamVByteEncodeDelta(const uint32_t* values, size_t count, uint32_t previous, vector<uint8_t>& out) {
+    vector<uint32_t> deltas(count);
+    for (size_t i = 0; i < count; ++i) {
+        deltas[i] = values[i] - previous;
+        previous = values[i];
+    }
+    StreamVByteEncode(deltas.data(), count, out);
+}
+
+const uint8_t* StreamVByteDecodeScalar(const uint8_t* in, size_t count, uint32_t* values) {
+    const uint8_t* data = in + count / 4;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t length = ((in[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        values[i] = ReadValue(data, length);
+        data += length;
+    }
+    return data;
+}
+
+const uint8_t* StreamVByteDecodeDeltaScalar(const uint8_t* in, size_t count, uint32_t previous, uint32_t* values) {
+    const uint8_t* end = StreamVByteDecodeScalar(in, count, values);
+    for (size_t i = 0; i < count; ++i) {
+        previous += values[i];
+        values[i] = previous;
+    }
+    return end;
+}
+
+const uint8_t* StreamVByteDecode(const uint8_t* in, size_t count, uint32_t* values) {
+#ifdef STREAM_VBYTE_SIMD
+    if (StreamVByteHasSimd()) {
+        return DecodeSimd<false>(in, count, 0, values);
+    }
+#endif
+    return StreamVByteDecodeScalar(in, count, values);
+}
+
+const uint8_t* StreamVByteDecodeDelta(const uint8_t* in, size_t count, uint32_t previous, uint32_t* values) {
+#ifdef STREAM_VBYTE_SIMD
+    if (StreamVByteHasSimd()) {
+        return DecodeSimd<true>(in, count, previous, values);
+    }
+#endif
+    return StreamVByteDecodeDeltaScalar(in, count, previous, values);
+}
+
+bool StreamVByteHasSimd() {
+#ifdef STREAM_VBYTE_SIMD
+    static const bool has_simd = CpuHasSsse3();
+    return has_simd;
+#else
+    return false;
+#endif
+}
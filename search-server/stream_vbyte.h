@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Stream VByte: сначала управляющие байты (по 2 бита на число — его длина 1..4 байта),
+// затем байты самих чисел. Такой формат декодируется через SSSE3 по четыре числа за шаг;
+// поддержка SSSE3 проверяется во время выполнения. count должно быть кратно 4
+
+// Сколько байт можно прочитать за концом закодированных данных при SIMD-декодировании
+constexpr size_t STREAM_VBYTE_PADDING = 16;
+
+void StreamVByteEncode(const uint32_t* values, size_t count, std::vector<uint8_t>& out);
+
+// Кодирует разности соседних чисел; previous — число перед первым
+void StreamVByteEncodeDelta(const uint32_t* values, size_t count, uint32_t previous, std::vector<uint8_t>& out);
+
+// Возвращают указатель на байт за прочитанными данными
+const uint8_t* StreamVByteDecode(const uint8_t* in, size_t count, uint32_t* values);
+const uint8_t* StreamVByteDecodeDelta(const uint8_t* in, size_t count, uint32_t previous, uint32_t* values);
+
+// Скалярные версии; StreamVByteDecode* используют их, если процессор не поддерживает SSSE3
+const uint8_t* StreamVByteDecodeScalar(const uint8_t* in, size_t count, uint32_t* values);
+const uint8_t* StreamVByteDecodeDeltaScalar(const uint8_t* in, size_t count, uint32_t previous, uint32_t* values);
+
+// Поддерживает ли процессор SSSE3, то есть идёт ли декодирование через SIMD
+bool StreamVByteHasSimd();
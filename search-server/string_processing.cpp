@@ -1,6 +1,71 @@
 #include "string_processing.h"
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define STRING_PROCESSING_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 using namespace std;
 
+namespace {
+
+bool IsControlChar(char c) {
+    return c >= '\0' && c < ' ';
+}
+
+int CountTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+#ifdef STRING_PROCESSING_SSE2
+
+constexpr size_t CHUNK_SIZE = 32;
+
+// Битовые маски пробелов и управляющих символов для 32 байт текста
+struct ChunkMasks {
+    uint32_t spaces;
+    uint32_t controls;
+};
+
+ChunkMasks ClassifyChunk(const char* data) {
+#if defined(__AVX2__)
+    const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    const __m256i spaces = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+    const __m256i controls = _mm256_andnot_si256(_mm256_cmpgt_epi8(_mm256_setzero_si256(), bytes),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(' '), bytes));
+    return { static_cast<uint32_t>(_mm256_movemask_epi8(spaces)), static_cast<uint32_t>(_mm256_movemask_epi8(controls)) };
+#else
+    ChunkMasks masks{ 0, 0 };
+    for (int half = 0; half < 2; ++half) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * half));
+        const __m128i spaces = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+        // Управляющие символы: 0 <= c < ' ' при знаковом сравнении, как в IsValidWord
+        const __m128i controls = _mm_andnot_si128(_mm_cmplt_epi8(bytes, _mm_setzero_si128()),
+            _mm_cmplt_epi8(bytes, _mm_set1_epi8(' ')));
+        masks.spaces |= static_cast<uint32_t>(_mm_movemask_epi8(spaces)) << (16 * half);
+        masks.controls |= static_cast<uint32_t>(_mm_movemask_epi8(controls)) << (16 * half);
+    }
+    return masks;
+#endif
+}
+
+#endif
+
+}  // namespace
+
 vector<string> SplitIntoWords(const string_view text) {
     vector<string> words;
     string word;
@@ -48,6 +113,61 @@ vector<string_view> SplitIntoWordsView(string_view str) {
 }
 
 
+bool SplitIntoValidWords(string_view text, vector<string_view>& words) {
+    words.clear();
+    const char* data = text.data();
+    const size_t size = text.size();
+    size_t word_begin = 0;
+    bool in_word = false;
+    size_t pos = 0;
+
+#ifdef STRING_PROCESSING_SSE2
+    for (; pos + CHUNK_SIZE <= size; pos += CHUNK_SIZE) {
+        const ChunkMasks masks = ClassifyChunk(data + pos);
+        if (masks.controls != 0) {
+            return false;
+        }
+        // Бит i в boundaries — позиция i не такая, как предыдущая (пробел/не пробел):
+        // здесь слово начинается или заканчивается
+        const uint32_t letters = ~masks.spaces;
+        const uint32_t previous_letters = (letters << 1) | (in_word ? 1u : 0u);
+        uint32_t boundaries = letters ^ previous_letters;
+        while (boundaries != 0) {
+            const size_t offset = pos + CountTrailingZeros(boundaries);
+            if (in_word) {
+                words.emplace_back(data + word_begin, offset - word_begin);
+            }
+            else {
+                word_begin = offset;
+            }
+            in_word = !in_word;
+            boundaries &= boundaries - 1;
+        }
+    }
+#endif
+
+    for (; pos < size; ++pos) {
+        const char c = data[pos];
+        if (IsControlChar(c)) {
+            return false;
+        }
+        if (c == ' ') {
+            if (in_word) {
+                words.emplace_back(data + word_begin, pos - word_begin);
+                in_word = false;
+            }
+        }
+        else if (!in_word) {
+            word_begin = pos;
+            in_word = true;
+        }
+    }
+    if (in_word) {
+        words.emplace_back(data + word_begin, size - word_begin);
+    }
+    return true;
+}
+
 void RemoveDuplicateWords(vector<string_view>& vec) {
     sort(vec.begin(), vec.end());
     vec.erase(unique(vec.begin(), vec.end()), vec.end());
@@ -9,6 +9,12 @@
 std::vector<std::string> SplitIntoWords(const std::string_view);
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
 
+// Разбивает текст на слова по пробелам и за тот же проход проверяет, что в нём нет
+// управляющих символов (коды 0..31). Границы ищутся по 16-32 байта за шаг (SSE2/AVX2).
+// Слова записываются в буфер вызывающего (он очищается), поэтому при повторных вызовах
+// память не выделяется. Возвращает false, если встретился управляющий символ; содержимое words тогда не определено
+bool SplitIntoValidWords(std::string_view text, std::vector<std::string_view>& words);
+
 void RemoveDuplicateWords(std::vector<std::string_view>&);
 
 template <typename ExecutionPolicy>
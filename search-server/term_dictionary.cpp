@@ -0,0 +1,143 @@
+#include "term_dictionary.h"
+#include <cstring>
+#include <functional>
+using namespace std;
+
+TermDictionary::TermDictionary()
+    : slots_(INITIAL_SLOT_COUNT, Slot{ 0, INVALID_TERM_ID }) {
+}
+
+TermId TermDictionary::Intern(string_view term) {
+    const uint32_t hash = static_cast<uint32_t>(Hash(term));
+    size_t slot = FindSlot(term, hash);
+    if (slots_[slot].term_id != INVALID_TERM_ID) {
+        return slots_[slot].term_id;
+    }
+    // Держим заполненность не выше половины, чтобы цепочки пробирования были короткими
+    if ((terms_.size() + 1) * 2 > slots_.size()) {
+        Rehash(slots_.size() * 2);
+        slot = FindSlot(term, hash);
+    }
+    TermId term_id;
+    if (free_term_ids_.empty()) {
+        term_id = static_cast<TermId>(terms_.size());
+        terms_.push_back(CopyToArena(term));
+    }
+    else {
+        term_id = free_term_ids_.back();
+        free_term_ids_.pop_back();
+        terms_[term_id] = CopyToArena(term);
+    }
+    slots_[slot] = { hash, term_id };
+    live_bytes_ += term.size();
+    return term_id;
+}
+
+void TermDictionary::Erase(TermId term_id) {
+    const size_t mask = slots_.size() - 1;
+    size_t hole = static_cast<uint32_t>(Hash(terms_[term_id])) & mask;
+    while (slots_[hole].term_id != term_id) {
+        hole = (hole + 1) & mask;
+    }
+    // Удаление со сдвигом назад, как в ConcurrentMap: цепочки пробирования остаются целыми
+    for (size_t next = (hole + 1) & mask; slots_[next].term_id != INVALID_TERM_ID; next = (next + 1) & mask) {
+        const size_t home = slots_[next].hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            slots_[hole] = slots_[next];
+            hole = next;
+        }
+    }
+    slots_[hole] = { 0, INVALID_TERM_ID };
+    live_bytes_ -= terms_[term_id].size();
+    terms_[term_id] = {};
+    free_term_ids_.push_back(term_id);
+}
+
+void TermDictionary::AssignExternal(vector<string_view> terms, vector<TermId> free_term_ids) {
+    size_t slot_count = INITIAL_SLOT_COUNT;
+    while (terms.size() * 2 > slot_count) {
+        slot_count *= 2;
+    }
+    slots_.assign(slot_count, Slot{ 0, INVALID_TERM_ID });
+    terms_ = move(terms);
+    free_term_ids_ = move(free_term_ids);
+    arena_blocks_.clear();
+    arena_block_free_ = 0;
+    arena_position_ = nullptr;
+    arena_size_ = 0;
+    live_bytes_ = 0;
+    // Хеши не хранятся в снимке: они зависят от реализации std::hash
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        const string_view term = terms_[term_id];
+        if (term.empty()) {
+            continue;
+        }
+        const uint32_t hash = static_cast<uint32_t>(Hash(term));
+        slots_[FindSlot(term, hash)] = { hash, term_id };
+        live_bytes_ += term.size();
+    }
+}
+
+TermId TermDictionary::Find(string_view term) const {
+    return slots_[FindSlot(term, static_cast<uint32_t>(Hash(term)))].term_id;
+}
+
+uint64_t TermDictionary::Hash(string_view term) {
+    return hash<string_view>{}(term);
+}
+
+size_t TermDictionary::FindSlot(string_view term, uint32_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const Slot& candidate = slots_[slot];
+        if (candidate.term_id == INVALID_TERM_ID
+            || (candidate.hash == hash && terms_[candidate.term_id] == term)) {
+            return slot;
+        }
+    }
+}
+
+string_view TermDictionary::CopyToArena(string_view term) {
+    if (term.size() > arena_block_free_) {
+        const size_t block_size = max(ARENA_BLOCK_SIZE, term.size());
+        arena_blocks_.push_back(make_unique<char[]>(block_size));
+        arena_position_ = arena_blocks_.back().get();
+        arena_block_free_ = block_size;
+        arena_size_ += block_size;
+    }
+    memcpy(arena_position_, term.data(), term.size());
+    const string_view result(arena_position_, term.size());
+    arena_position_ += term.size();
+    arena_block_free_ -= term.size();
+    return result;
+}
+
+TermDictionary::ArenaBlocks TermDictionary::CompactArena() {
+    ArenaBlocks old_blocks;
+    old_blocks.swap(arena_blocks_);
+    arena_block_free_ = 0;
+    arena_position_ = nullptr;
+    arena_size_ = 0;
+    for (string_view& term : terms_) {
+        if (!term.empty()) {
+            term = CopyToArena(term);
+        }
+    }
+    return old_blocks;
+}
+
+void TermDictionary::Rehash(size_t slot_count) {
+    vector<Slot> slots(slot_count, Slot{ 0, INVALID_TERM_ID });
+    const size_t mask = slot_count - 1;
+    for (const Slot& old_slot : slots_) {
+        if (old_slot.term_id == INVALID_TERM_ID) {
+            continue;
+        }
+        size_t slot = old_slot.hash & mask;
+        while (slots[slot].term_id != INVALID_TERM_ID) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = old_slot;
+    }
+    slots_.swap(slots);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using TermId = uint32_t;
+constexpr TermId INVALID_TERM_ID = std::numeric_limits<TermId>::max();
+
+// Словарь слов индекса: каждое различное слово хранится один раз в арене
+// и получает 32-битный номер. Поиск идёт по хеш-таблице с открытой адресацией.
+// Представления, возвращаемые GetTerm, живут столько же, сколько словарь
+class TermDictionary {
+public:
+    TermDictionary();
+
+    TermDictionary(const TermDictionary&) = delete;
+    TermDictionary& operator=(const TermDictionary&) = delete;
+    // Блоки арены при перемещении остаются на месте, выданные представления не портятся
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(TermDictionary&&) = default;
+
+    // Возвращает номер слова, добавляя его при необходимости
+    TermId Intern(std::string_view term);
+
+    // Возвращает INVALID_TERM_ID, если слова нет
+    TermId Find(std::string_view term) const;
+
+    // Удаляет слово; его номер достанется следующему новому слову.
+    // Байты слова в арене освобождаются только при CompactArena
+    void Erase(TermId term_id);
+
+    // Заменяет содержимое словаря: terms[i] — слово с номером i, пустое для освобождённого номера.
+    // Байты слов не копируются в арену и должны жить, пока живёт словарь
+    void AssignExternal(std::vector<std::string_view> terms, std::vector<TermId> free_term_ids);
+
+    // Освобождённые номера; следующее новое слово получит последний из них
+    const std::vector<TermId>& FreeTermIds() const {
+        return free_term_ids_;
+    }
+
+    using ArenaBlocks = std::vector<std::unique_ptr<char[]>>;
+
+    // Переносит живые слова в новую арену без дыр от удалённых. Номера слов не меняются,
+    // GetTerm начинает возвращать представления в новую арену. Возвращает старые блоки:
+    // пока они живы, прежние представления остаются действительными и их можно заменить
+    [[nodiscard]] ArenaBlocks CompactArena();
+
+    // Арена занята удалёнными словами больше чем наполовину
+    bool NeedsCompaction() const {
+        return arena_size_ > ARENA_BLOCK_SIZE && live_bytes_ * 2 < arena_size_;
+    }
+
+    // Байт выделено под арену
+    size_t ArenaSize() const {
+        return arena_size_;
+    }
+
+    std::string_view GetTerm(TermId term_id) const {
+        return terms_[term_id];
+    }
+
+    // Граница номеров слов (включая освобождённые)
+    size_t size() const {
+        return terms_.size();
+    }
+
+private:
+    // Ячейка таблицы хранит часть хеша, чтобы при пробировании
+    // не обращаться к байтам слова без необходимости
+    struct Slot {
+        uint32_t hash;
+        TermId term_id;
+    };
+
+    static constexpr size_t ARENA_BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t INITIAL_SLOT_COUNT = 1024;
+
+    std::vector<Slot> slots_;
+    std::vector<std::string_view> terms_;
+    std::vector<TermId> free_term_ids_;
+    ArenaBlocks arena_blocks_;
+    size_t arena_block_free_ = 0;
+    char* arena_position_ = nullptr;
+    size_t arena_size_ = 0;
+    // Суммарная длина живых слов
+    size_t live_bytes_ = 0;
+
+    static uint64_t Hash(std::string_view term);
+
+    size_t FindSlot(std::string_view term, uint32_t hash) const;
+    std::string_view CopyToArena(std::string_view term);
+    void Rehash(size_t slot_count);
+};
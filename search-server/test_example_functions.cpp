@@ -0,0 +1,2219 @@
+#include "test_example_functions.h"
+#include "concurrent_map.h"
+#include "log_duration.h"
+#include "posting_list.h"
+#include "process_queries.h"
+#include "query_cache.h"
+#include "query_executor.h"
+#include "remove_duplicates.h"
+#include "request_queue.h"
+#include "search_server.h"
+#include "segmented_index.h"
+#include "stream_vbyte.h"
+#include "string_processing.h"
+#include "test_framework.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <execution>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace {
+
+// Аллокатор, считающий выделенные байты: нужен, чтобы честно измерить узлы std::map
+size_t allocated_bytes = 0;
+
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+        allocated_bytes += n * sizeof(T);
+        return allocator<T>{}.allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        allocated_bytes -= n * sizeof(T);
+        allocator<T>{}.deallocate(p, n);
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U>&) const {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const CountingAllocator<U>&) const {
+        return false;
+    }
+};
+
+using LegacyPostings = map<int, double, less<int>, CountingAllocator<pair<const int, double>>>;
+
+// Прежний ConcurrentMap: корзины без выравнивания, ключ по модулю, erase без блокировки
+// (здесь блокировка добавлена, чтобы сравнение было честным)
+template <typename Key, typename Value>
+class LegacyConcurrentMap {
+public:
+    explicit LegacyConcurrentMap(size_t bucket_count)
+        : buckets_(bucket_count) {
+    }
+
+    void Add(const Key& key, const Value& value) {
+        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+        lock_guard guard(bucket.mutex);
+        bucket.map[key] += value;
+    }
+
+    void erase(const Key& key) {
+        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+        lock_guard guard(bucket.mutex);
+        bucket.map.erase(key);
+    }
+
+private:
+    struct Bucket {
+        std::mutex mutex;
+        std::map<Key, Value> map;
+    };
+    vector<Bucket> buckets_;
+};
+
+template <typename Function>
+void RunThreads(unsigned thread_count, Function function) {
+    vector<thread> threads;
+    for (unsigned i = 0; i < thread_count; ++i) {
+        threads.emplace_back(function, i);
+    }
+    for (thread& worker : threads) {
+        worker.join();
+    }
+}
+
+// Номера слов документов с перекосом в сторону частых слов, как в живом тексте
+vector<vector<int>> GenerateCorpus(mt19937& generator, int document_count, int words_in_document, int vocabulary_size) {
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    vector<vector<int>> corpus(document_count);
+    for (auto& document : corpus) {
+        document.reserve(words_in_document);
+        for (int i = 0; i < words_in_document; ++i) {
+            const double x = uniform(generator);
+            document.push_back(static_cast<int>(x * x * x * (vocabulary_size - 1)));
+        }
+    }
+    return corpus;
+}
+
+// Текст документа корпуса: слово с номером i записывается как "w<i>"
+string GetCorpusText(const vector<int>& document) {
+    string text;
+    for (const int word : document) {
+        text += "w"s + to_string(word) + " "s;
+    }
+    return text;
+}
+
+vector<string> GetCorpusTexts(const vector<vector<int>>& corpus) {
+    vector<string> texts;
+    texts.reserve(corpus.size());
+    for (const auto& document : corpus) {
+        texts.push_back(GetCorpusText(document));
+    }
+    return texts;
+}
+
+size_t GetTotalSize(const vector<string>& texts) {
+    size_t bytes = 0;
+    for (const string& text : texts) {
+        bytes += text.size();
+    }
+    return bytes;
+}
+
+// Заполняет сервер документами корпуса, id документа — его номер в корпусе
+void AddCorpus(SearchServer& search_server, const vector<vector<int>>& corpus) {
+    for (int document_id = 0; document_id < static_cast<int>(corpus.size()); ++document_id) {
+        search_server.AddDocument(document_id, GetCorpusText(corpus[document_id]), DocumentStatus::ACTUAL, { document_id % 100 });
+    }
+}
+
+// Общий стенд замеров и проверок: корпус из генератора с зерном 42 и сервер со стоп-словами
+// "and with", заполненный этим корпусом. Генератор продолжает ту же последовательность
+struct CorpusServer {
+    explicit CorpusServer(int document_count, int words_in_document = 50, int vocabulary_size = 10000)
+        : corpus(GenerateCorpus(generator, document_count, words_in_document, vocabulary_size)) {
+        AddCorpus(search_server, corpus);
+    }
+
+    mt19937 generator{ 42 };
+    vector<vector<int>> corpus;
+    SearchServer search_server{ "and with"s };
+};
+
+// Запускает function и печатает скорость обработки bytes байт в МБ/с
+template <typename Function>
+void MeasureThroughput(ostream& out, const string& name, size_t bytes, Function function) {
+    const auto start = chrono::steady_clock::now();
+    function();
+    const chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+    out << name << ": "s << bytes / seconds.count() / (1 << 20) << " MB/s"s << endl;
+}
+
+}  // namespace
+
+void BenchmarkPostingLayout(ostream& out, int document_count, int words_in_document) {
+    const int vocabulary_size = 10000;
+    mt19937 generator(42);
+    const auto corpus = GenerateCorpus(generator, document_count, words_in_document, vocabulary_size);
+
+    allocated_bytes = 0;
+    vector<LegacyPostings> legacy(vocabulary_size);
+    vector<PostingList> flat(vocabulary_size);
+    const double inv_word_count = 1.0 / words_in_document;
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        map<int, double> word_freqs;
+        for (const int word : corpus[document_id]) {
+            word_freqs[word] += inv_word_count;
+        }
+        for (const auto [word, term_freq] : word_freqs) {
+            legacy[word][document_id] = term_freq;
+            flat[word].Insert(document_id, term_freq);
+        }
+    }
+
+    size_t flat_bytes = 0;
+    size_t posting_count = 0;
+    for (const PostingList& postings : flat) {
+        flat_bytes += postings.DocumentIds().capacity() * sizeof(int) + postings.TermFreqs().capacity() * sizeof(double);
+        posting_count += postings.size();
+    }
+    out << "Postings: "s << posting_count << endl;
+    out << "map<int, double>: "s << allocated_bytes << " bytes, "s
+        << static_cast<double>(allocated_bytes) / posting_count << " bytes per posting"s << endl;
+    out << "PostingList: "s << flat_bytes << " bytes, "s
+        << static_cast<double>(flat_bytes) / posting_count << " bytes per posting"s << endl;
+
+    vector<vector<int>> queries(1000);
+    uniform_int_distribution<int> word_distribution(0, 200);
+    for (auto& query : queries) {
+        for (int i = 0; i < 3; ++i) {
+            query.push_back(word_distribution(generator));
+        }
+    }
+
+    vector<double> relevance(document_count);
+    double checksum = 0.0;
+    {
+        LOG_DURATION_STREAM("map<int, double> scan"s, out);
+        for (const auto& query : queries) {
+            for (const int word : query) {
+                for (const auto [document_id, term_freq] : legacy[word]) {
+                    relevance[document_id] += term_freq;
+                }
+            }
+        }
+        checksum += relevance[0];
+    }
+    fill(relevance.begin(), relevance.end(), 0.0);
+    {
+        LOG_DURATION_STREAM("PostingList scan"s, out);
+        for (const auto& query : queries) {
+            for (const int word : query) {
+                const vector<int>& document_ids = flat[word].DocumentIds();
+                const vector<double>& term_freqs = flat[word].TermFreqs();
+                for (size_t i = 0; i < document_ids.size(); ++i) {
+                    relevance[document_ids[i]] += term_freqs[i];
+                }
+            }
+        }
+        checksum -= relevance[0];
+    }
+    out << "Checksum difference: "s << checksum << endl;
+}
+
+void BenchmarkParallelScoring(ostream& out, int document_count, int words_in_document) {
+    CorpusServer fixture(document_count, words_in_document);
+    const SearchServer& search_server = fixture.search_server;
+
+    // Самые частые слова корпуса: каждый запрос обходит длинные списки
+    vector<string> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back("w"s + to_string(i % 10) + " w"s + to_string(10 + i % 20) + " w"s + to_string(30 + i));
+    }
+
+    out << "Hardware threads: "s << thread::hardware_concurrency() << endl;
+    size_t checksum = 0;
+    {
+        LOG_DURATION_STREAM("Sequential FindTopDocuments"s, out);
+        for (const string& query : queries) {
+            checksum += search_server.FindTopDocuments(execution::seq, query).size();
+        }
+    }
+    {
+        LOG_DURATION_STREAM("Parallel FindTopDocuments"s, out);
+        for (const string& query : queries) {
+            checksum -= search_server.FindTopDocuments(execution::par, query).size();
+        }
+    }
+    out << "Checksum difference: "s << checksum << endl;
+}
+
+void BenchmarkConcurrentMap(ostream& out, int operations_per_thread) {
+    const int key_count = 100000;
+    const size_t shard_count = 100;
+    for (const unsigned thread_count : { 1u, 4u, max(1u, thread::hardware_concurrency()) }) {
+        out << "Threads: "s << thread_count << endl;
+        {
+            LegacyConcurrentMap<int, double> legacy(shard_count);
+            LOG_DURATION_STREAM("Legacy ConcurrentMap"s, out);
+            RunThreads(thread_count, [&legacy, operations_per_thread](unsigned seed) {
+                mt19937 generator(seed);
+                for (int i = 0; i < operations_per_thread; ++i) {
+                    const int key = static_cast<int>(generator() % key_count);
+                    if (i % 8 == 0) {
+                        legacy.erase(key);
+                    }
+                    else {
+                        legacy.Add(key, 1.0);
+                    }
+                }
+            });
+        }
+        {
+            ConcurrentMap<int, double> sharded(shard_count);
+            LOG_DURATION_STREAM("ConcurrentMap"s, out);
+            RunThreads(thread_count, [&sharded, operations_per_thread](unsigned seed) {
+                mt19937 generator(seed);
+                for (int i = 0; i < operations_per_thread; ++i) {
+                    const int key = static_cast<int>(generator() % key_count);
+                    if (i % 8 == 0) {
+                        sharded.erase(key);
+                    }
+                    else {
+                        sharded[key].ref_to_value += 1.0;
+                    }
+                }
+            });
+        }
+    }
+}
+
+void BenchmarkPostingCompression(ostream& out, int document_count, int words_in_document) {
+    const int vocabulary_size = 10000;
+    mt19937 generator(42);
+    const auto corpus = GenerateCorpus(generator, document_count, words_in_document, vocabulary_size);
+
+    const vector<int> word_counts(document_count, words_in_document);
+    const double inv_word_count = 1.0 / words_in_document;
+    vector<PostingList> postings(vocabulary_size);
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        map<int, int> word_occurrences;
+        for (const int word : corpus[document_id]) {
+            ++word_occurrences[word];
+        }
+        for (const auto [word, count] : word_occurrences) {
+            postings[word].Insert(document_id, count * inv_word_count);
+        }
+    }
+
+    size_t posting_count = 0;
+    size_t raw_bytes = 0;
+    for (PostingList& list : postings) {
+        list.Compress(word_counts.data());
+        list.Decompress(word_counts.data());
+        posting_count += list.size();
+        raw_bytes += list.MemoryUsage();
+    }
+    const auto scan = [&postings, &word_counts](double& checksum) {
+        for (const PostingList& list : postings) {
+            for (PostingCursor cursor(list, word_counts.data()); !cursor.AtEnd(); cursor.Next()) {
+                checksum += cursor.TermFreq();
+            }
+        }
+    };
+    double checksum = 0.0;
+    {
+        LOG_DURATION_STREAM("Raw postings scan"s, out);
+        scan(checksum);
+    }
+
+    size_t compressed_bytes = 0;
+    for (PostingList& list : postings) {
+        list.Compress(word_counts.data());
+        compressed_bytes += list.MemoryUsage();
+    }
+    {
+        LOG_DURATION_STREAM("Compressed postings scan"s, out);
+        scan(checksum);
+    }
+    out << "Postings: "s << posting_count << endl;
+    out << "Raw: "s << static_cast<double>(raw_bytes) / posting_count << " bytes per posting"s << endl;
+    out << "Compressed: "s << static_cast<double>(compressed_bytes) / posting_count << " bytes per posting"s << endl;
+    out << "Checksum: "s << checksum << endl;
+
+    // Чистая скорость декодирования разностей id: SIMD против скалярной версии
+    vector<uint32_t> document_ids;
+    for (int i = 0; document_ids.size() < 1u << 24; i += 1 + static_cast<int>(generator() % 64)) {
+        document_ids.push_back(static_cast<uint32_t>(i));
+    }
+    vector<uint8_t> encoded;
+    StreamVByteEncodeDelta(document_ids.data(), document_ids.size(), 0, encoded);
+    encoded.resize(encoded.size() + STREAM_VBYTE_PADDING);
+    vector<uint32_t> decoded(document_ids.size());
+    const auto measure = [&](const string& name, auto decode) {
+        const auto start = chrono::steady_clock::now();
+        decode(encoded.data(), decoded.size(), 0u, decoded.data());
+        const chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+        out << name << ": "s << decoded.size() / seconds.count() / 1e6 << " million ids/s"s
+            << (decoded == document_ids ? ""s : " (MISMATCH)"s) << endl;
+    };
+    out << "SIMD available: "s << (StreamVByteHasSimd() ? "yes"s : "no"s) << endl;
+    measure("Scalar decode"s, StreamVByteDecodeDeltaScalar);
+    measure("Decode"s, StreamVByteDecodeDelta);
+}
+
+void BenchmarkTokenizer(ostream& out, int document_count, int words_in_document) {
+    mt19937 generator(42);
+    const auto corpus = GenerateCorpus(generator, document_count, words_in_document, 10000);
+    vector<string> texts;
+    size_t total_bytes = 0;
+    for (const auto& document : corpus) {
+        string text;
+        for (const int word : document) {
+            text += "w"s + to_string(word) + (word % 3 == 0 ? "  "s : " "s);
+        }
+        total_bytes += text.size();
+        texts.push_back(move(text));
+    }
+
+    size_t word_count = 0;
+    MeasureThroughput(out, "SplitIntoWordsView + validation"s, total_bytes, [&] {
+        for (const string& text : texts) {
+            for (const string_view word : SplitIntoWordsView(text)) {
+                word_count += none_of(word.begin(), word.end(), [](char c) { return c >= '\0' && c < ' '; });
+            }
+        }
+    });
+    vector<string_view> words;
+    MeasureThroughput(out, "SplitIntoValidWords"s, total_bytes, [&] {
+        for (const string& text : texts) {
+            word_count -= SplitIntoValidWords(text, words) ? words.size() : 0;
+        }
+    });
+    out << "Word count difference: "s << word_count << endl;
+
+    SearchServer search_server("and with"s);
+    MeasureThroughput(out, "AddDocument"s, total_bytes, [&] {
+        for (int document_id = 0; document_id < document_count; ++document_id) {
+            search_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, { 1 });
+        }
+    });
+}
+
+void BenchmarkQueryCache(ostream& out, int document_count, int query_count) {
+    CorpusServer fixture(document_count);
+    SearchServer& search_server = fixture.search_server;
+    mt19937& generator = fixture.generator;
+
+    // Перекошенный поток: небольшая доля различных запросов даёт большую часть обращений
+    vector<string> distinct_queries;
+    uniform_int_distribution<int> word_distribution(0, 500);
+    for (int i = 0; i < 1000; ++i) {
+        distinct_queries.push_back("w"s + to_string(word_distribution(generator)) + " w"s + to_string(word_distribution(generator)));
+    }
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    vector<string> queries;
+    for (int i = 0; i < query_count; ++i) {
+        const double x = uniform(generator);
+        queries.push_back(distinct_queries[static_cast<size_t>(x * x * x * x * distinct_queries.size())]);
+    }
+
+    size_t checksum = 0;
+    search_server.SetQueryCacheCapacity(0);
+    {
+        LOG_DURATION_STREAM("Without cache"s, out);
+        for (const string& query : queries) {
+            checksum += search_server.FindTopDocuments(query).size();
+        }
+    }
+    search_server.SetQueryCacheCapacity(QUERY_CACHE_DEFAULT_CAPACITY);
+    {
+        LOG_DURATION_STREAM("With cache"s, out);
+        for (const string& query : queries) {
+            checksum -= search_server.FindTopDocuments(query).size();
+        }
+    }
+    const QueryCache::Stats stats = search_server.GetQueryCacheStats();
+    out << "Hits: "s << stats.hits << ", misses: "s << stats.misses << ", evictions: "s << stats.evictions
+        << ", size: "s << stats.size << endl;
+    out << "Checksum difference: "s << checksum << endl;
+}
+
+void BenchmarkRemoveDocuments(ostream& out, int document_count, int words_in_document) {
+    mt19937 generator(42);
+    const auto corpus = GenerateCorpus(generator, document_count, words_in_document, 10000);
+    // Удаляется каждый пятый документ, как при ночной чистке BANNED
+    vector<int> removed_ids;
+    for (int document_id = 0; document_id < document_count; document_id += 5) {
+        removed_ids.push_back(document_id);
+    }
+
+    SearchServer one_by_one("and with"s);
+    AddCorpus(one_by_one, corpus);
+    {
+        LOG_DURATION_STREAM("RemoveDocument one by one"s, out);
+        for (const int document_id : removed_ids) {
+            one_by_one.RemoveDocument(document_id);
+        }
+        one_by_one.CompactIndex();
+    }
+
+    SearchServer batch("and with"s);
+    AddCorpus(batch, corpus);
+    {
+        LOG_DURATION_STREAM("RemoveDocuments"s, out);
+        batch.RemoveDocuments(removed_ids);
+    }
+    out << "Document count difference: "s << one_by_one.GetDocumentCount() - batch.GetDocumentCount() << endl;
+}
+
+void BenchmarkTermStorageChurn(ostream& out, int rounds, int documents_per_round) {
+    SearchServer search_server("and with"s);
+    int next_document_id = 0;
+    search_server.AddDocument(next_document_id++, "common base document"s, DocumentStatus::ACTUAL, { 1 });
+    for (int round = 1; round <= rounds; ++round) {
+        // Каждый раунд добавляет документы с новыми словами и удаляет их
+        vector<int> document_ids;
+        for (int i = 0; i < documents_per_round; ++i) {
+            search_server.AddDocument(next_document_id, "session"s + to_string(next_document_id) + " token"s
+                + to_string(next_document_id * 7919) + " common"s, DocumentStatus::ACTUAL, { 1 });
+            document_ids.push_back(next_document_id++);
+        }
+        search_server.RemoveDocuments(document_ids);
+        // Выданных раньше слов никто не держит
+        search_server.ReleaseRetiredTerms();
+        if (round % (rounds / 10 == 0 ? 1 : rounds / 10) == 0) {
+            out << "Round "s << round << ": term storage "s << search_server.GetTermStorageSize() << " bytes"s << endl;
+        }
+    }
+}
+
+void BenchmarkAddDocuments(ostream& out, int document_count, int words_in_document) {
+    mt19937 generator(42);
+    const vector<string> texts = GetCorpusTexts(GenerateCorpus(generator, document_count, words_in_document, 10000));
+    const size_t total_bytes = GetTotalSize(texts);
+    vector<DocumentToAdd> documents;
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        documents.push_back({ document_id, texts[document_id], DocumentStatus::ACTUAL, { document_id % 100 } });
+    }
+
+    SearchServer one_by_one("and with"s);
+    MeasureThroughput(out, "AddDocument one by one"s, total_bytes, [&] {
+        for (const DocumentToAdd& document : documents) {
+            one_by_one.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+    });
+    SearchServer sequential("and with"s);
+    MeasureThroughput(out, "AddDocuments seq"s, total_bytes, [&] {
+        sequential.AddDocuments(execution::seq, documents);
+    });
+    SearchServer parallel("and with"s);
+    MeasureThroughput(out, "AddDocuments par"s, total_bytes, [&] {
+        parallel.AddDocuments(execution::par, documents);
+    });
+    out << "Document count difference: "s << one_by_one.GetDocumentCount() - parallel.GetDocumentCount() << endl;
+}
+
+void BenchmarkSnapshot(ostream& out, int document_count, int words_in_document) {
+    const string path = "search_server_benchmark.snapshot"s;
+    mt19937 generator(42);
+    const auto corpus = GenerateCorpus(generator, document_count, words_in_document, 10000);
+    {
+        SearchServer search_server("and with"s);
+        {
+            LOG_DURATION_STREAM("Rebuild with AddDocument"s, out);
+            AddCorpus(search_server, corpus);
+        }
+        LOG_DURATION_STREAM("SaveSnapshot"s, out);
+        search_server.SaveSnapshot(path);
+    }
+    size_t result_count = 0;
+    {
+        LOG_DURATION_STREAM("LoadSnapshot and first query"s, out);
+        const SearchServer search_server = SearchServer::LoadSnapshot(path);
+        result_count = search_server.FindTopDocuments("w1 w2 w3"s).size();
+    }
+    out << "Results: "s << result_count << endl;
+    remove(path.c_str());
+}
+
+void BenchmarkSegmentedIndex(ostream& out, int document_count, int query_count) {
+    mt19937 generator(42);
+    const vector<string> texts = GetCorpusTexts(GenerateCorpus(generator, document_count, 50, 10000));
+    vector<string> queries;
+    uniform_int_distribution<int> word_distribution(0, 2000);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back("w"s + to_string(word_distribution(generator)) + " w"s + to_string(word_distribution(generator))
+            + " -w"s + to_string(word_distribution(generator)));
+    }
+
+    // Загрузка вперемешку с удалениями: после каждых пяти документов удаляется один из старых
+    const auto ingest = [&](auto& index) {
+        for (int document_id = 0; document_id < document_count; ++document_id) {
+            index.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, { document_id % 100 });
+            if (document_id % 5 == 4) {
+                index.RemoveDocument(document_id / 2);
+            }
+        }
+    };
+    size_t checksum = 0;
+    SearchServer search_server("and with"s);
+    {
+        LOG_DURATION_STREAM("SearchServer ingest with deletes"s, out);
+        ingest(search_server);
+    }
+    search_server.SetQueryCacheCapacity(0);
+    {
+        LOG_DURATION_STREAM("SearchServer queries"s, out);
+        for (const string& query : queries) {
+            checksum += search_server.FindTopDocuments(query).size();
+        }
+    }
+    SegmentedIndex segmented_index("and with"s);
+    {
+        LOG_DURATION_STREAM("SegmentedIndex ingest with deletes"s, out);
+        ingest(segmented_index);
+        segmented_index.WaitForMerges();
+    }
+    {
+        LOG_DURATION_STREAM("SegmentedIndex queries"s, out);
+        for (const string& query : queries) {
+            checksum -= segmented_index.FindTopDocuments(query).size();
+        }
+    }
+    out << "Segments: "s << segmented_index.GetSegmentCount() << ", checksum difference: "s << checksum << endl;
+}
+
+void StressSegmentedIndexViews(ostream& out, int document_count, unsigned reader_count, unsigned writer_count) {
+    mt19937 generator(42);
+    const auto corpus = GenerateCorpus(generator, document_count, 30, 5000);
+    vector<string> queries;
+    uniform_int_distribution<int> word_distribution(0, 1000);
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back("w"s + to_string(word_distribution(generator)) + " w"s + to_string(word_distribution(generator))
+            + " -w"s + to_string(word_distribution(generator)));
+    }
+
+    // Маленький изменяемый сегмент, чтобы представления публиковались часто и шли слияния
+    SegmentedIndex index("and with"s, 256);
+    // Увеличивается до AddDocument: в представлении не может быть больше документов
+    atomic<int> started_count = 0;
+    atomic<bool> done = false;
+    atomic<size_t> view_count = 0;
+    atomic<size_t> query_count = 0;
+    atomic<size_t> inconsistency_count = 0;
+    thread writers([&] {
+        RunThreads(writer_count, [&](unsigned writer) {
+            for (int document_id = writer; document_id < document_count; document_id += writer_count) {
+                const string text = GetCorpusText(corpus[document_id]);
+                ++started_count;
+                index.AddDocument(document_id, text, DocumentStatus::ACTUAL, { document_id % 100 });
+                if (document_id % 5 == 4) {
+                    index.RemoveDocument(document_id / 2);
+                }
+            }
+        });
+        index.Flush();
+        index.WaitForMerges();
+        done.store(true);
+    });
+    // Читатели проверяют, что представление не меняется под ними: повторный запрос даёт тот же ответ
+    RunThreads(reader_count, [&](unsigned reader) {
+        for (size_t i = reader; !done.load(); ++i) {
+            const shared_ptr<const SegmentedIndex::View> view = index.GetView();
+            ++view_count;
+            if (view->GetDocumentCount() > started_count.load()) {
+                ++inconsistency_count;
+            }
+            const string& query = queries[i % queries.size()];
+            const vector<Document> first = view->FindTopDocuments(query);
+            const vector<Document> second = view->FindTopDocuments(query);
+            query_count += 2;
+            const bool same = equal(first.begin(), first.end(), second.begin(), second.end(),
+                [](const Document& lhs, const Document& rhs) {
+                    return lhs.id == rhs.id && lhs.relevance == rhs.relevance && lhs.rating == rhs.rating;
+                });
+            if (!same || any_of(first.begin(), first.end(), [document_count](const Document& document) {
+                return document.id < 0 || document.id >= document_count;
+                })) {
+                ++inconsistency_count;
+            }
+        }
+    });
+    writers.join();
+    out << "Views: "s << view_count << ", queries: "s << query_count << ", inconsistencies: "s << inconsistency_count
+        << ", final documents: "s << index.GetView()->GetDocumentCount() << endl;
+}
+
+void BenchmarkConcurrentAddDocument(ostream& out, int document_count) {
+    mt19937 generator(42);
+    const vector<string> texts = GetCorpusTexts(GenerateCorpus(generator, document_count, 50, 10000));
+    const size_t bytes = GetTotalSize(texts);
+    {
+        SearchServer search_server("and with"s);
+        MeasureThroughput(out, "SearchServer, 1 thread"s, bytes, [&] {
+            for (int document_id = 0; document_id < document_count; ++document_id) {
+                search_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, { document_id % 100 });
+            }
+        });
+    }
+    for (const unsigned thread_count : { 1u, 4u, 16u, 32u }) {
+        SegmentedIndex index("and with"s);
+        MeasureThroughput(out, "SegmentedIndex, "s + to_string(thread_count) + " threads"s, bytes, [&] {
+            // Поток t добавляет документы t, t + thread_count, ...
+            RunThreads(thread_count, [&](unsigned thread_index) {
+                for (int document_id = thread_index; document_id < document_count; document_id += thread_count) {
+                    index.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, { document_id % 100 });
+                }
+            });
+            index.Flush();
+        });
+        if (index.GetDocumentCount() != document_count) {
+            out << "Lost documents: "s << document_count - index.GetDocumentCount() << endl;
+        }
+        index.WaitForMerges();
+    }
+}
+
+void BenchmarkQueryExecutor(ostream& out, int document_count, int query_count) {
+    CorpusServer fixture(document_count);
+    SearchServer& search_server = fixture.search_server;
+    mt19937& generator = fixture.generator;
+    search_server.SetQueryCacheCapacity(0);
+    // Четыре из пяти запросов короткие, остальные — из двадцати слов с минус-словами
+    vector<string> queries;
+    uniform_int_distribution<int> word_distribution(0, 3000);
+    for (int i = 0; i < query_count; ++i) {
+        const int word_count = i % 5 == 0 ? 20 : 1 + i % 2;
+        string query;
+        for (int j = 0; j < word_count; ++j) {
+            query += (j % 7 == 6 ? "-w"s : "w"s) + to_string(word_distribution(generator)) + " "s;
+        }
+        queries.push_back(move(query));
+    }
+
+    vector<vector<Document>> reference;
+    {
+        LOG_DURATION_STREAM("ProcessQueries, execution::par"s, out);
+        reference = ProcessQueries(search_server, queries);
+    }
+    vector<size_t> worker_counts{ 1, 4, max(1u, thread::hardware_concurrency()) };
+    sort(worker_counts.begin(), worker_counts.end());
+    worker_counts.erase(unique(worker_counts.begin(), worker_counts.end()), worker_counts.end());
+    for (const size_t worker_count : worker_counts) {
+        QueryExecutor executor(worker_count);
+        QueryResults results;
+        {
+            LOG_DURATION_STREAM("ProcessQueries, QueryExecutor with "s + to_string(worker_count) + " workers"s, out);
+            results = ProcessQueries(executor, search_server, queries);
+        }
+        size_t mismatches = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            auto range = results[i];
+            if (!equal(range.begin(), range.end(), reference[i].begin(), reference[i].end(),
+                [](const Document& lhs, const Document& rhs) { return lhs.id == rhs.id; })) {
+                ++mismatches;
+            }
+        }
+        const QueryExecutor::Stats stats = executor.GetStats();
+        out << "Executed: "s << stats.executed << ", stolen: "s << stats.stolen << ", mismatches: "s << mismatches << endl;
+    }
+}
+
+void BenchmarkBatchQueries(ostream& out, int document_count, int query_count) {
+    CorpusServer fixture(document_count);
+    SearchServer& search_server = fixture.search_server;
+    mt19937& generator = fixture.generator;
+    search_server.SetQueryCacheCapacity(0);
+    // Запросы из двух-трёх популярных слов; в каждом четвёртом есть минус-слово
+    vector<string> queries;
+    uniform_int_distribution<int> word_distribution(0, 300);
+    for (int i = 0; i < query_count; ++i) {
+        string query;
+        for (int j = 0, word_count = 2 + i % 2; j < word_count; ++j) {
+            query += "w"s + to_string(word_distribution(generator)) + " "s;
+        }
+        if (i % 4 == 0) {
+            query += "-w"s + to_string(word_distribution(generator));
+        }
+        queries.push_back(move(query));
+    }
+
+    vector<vector<Document>> reference;
+    {
+        LOG_DURATION_STREAM("FindTopDocuments for each query"s, out);
+        reference.reserve(queries.size());
+        for (const string& query : queries) {
+            reference.push_back(search_server.FindTopDocuments(query));
+        }
+    }
+    {
+        LOG_DURATION_STREAM("ProcessQueries, execution::par"s, out);
+        ProcessQueries(search_server, queries);
+    }
+    vector<vector<Document>> results;
+    {
+        LOG_DURATION_STREAM("FindTopDocumentsBatch"s, out);
+        results = search_server.FindTopDocumentsBatch(queries);
+    }
+    size_t mismatches = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        if (!equal(results[i].begin(), results[i].end(), reference[i].begin(), reference[i].end(),
+            [](const Document& lhs, const Document& rhs) {
+                return lhs.id == rhs.id && lhs.relevance == rhs.relevance && lhs.rating == rhs.rating;
+            })) {
+            ++mismatches;
+        }
+    }
+    out << "Mismatches: "s << mismatches << endl;
+}
+
+void BenchmarkRemoveDuplicates(ostream& out, int document_count) {
+    mt19937 generator(42);
+    auto corpus = GenerateCorpus(generator, document_count, 50, 10000);
+    // Каждый пятый документ — копия одного из предыдущих с переставленными словами
+    for (int i = 5; i < document_count; i += 5) {
+        corpus[i] = corpus[uniform_int_distribution<int>(0, i - 1)(generator)];
+        shuffle(corpus[i].begin(), corpus[i].end(), generator);
+    }
+    SearchServer search_server("and with"s);
+    AddCorpus(search_server, corpus);
+
+    size_t legacy_duplicates = 0;
+    {
+        LOG_DURATION_STREAM("Concatenated words in set<string>"s, out);
+        set<string> document_words_set;
+        for (const int document_id : search_server) {
+            string words;
+            for (const auto& [word, freq] : search_server.GetWordFrequencies(document_id)) {
+                words += word;
+            }
+            legacy_duplicates += document_words_set.insert(move(words)).second ? 0 : 1;
+        }
+    }
+    vector<int> duplicates;
+    {
+        LOG_DURATION_STREAM("FindDuplicates"s, out);
+        duplicates = FindDuplicates(search_server);
+    }
+    {
+        LOG_DURATION_STREAM("RemoveDocuments"s, out);
+        search_server.RemoveDocuments(duplicates);
+    }
+    out << "Duplicates: "s << duplicates.size() << " (set<string>: "s << legacy_duplicates << "), documents left: "s
+        << search_server.GetDocumentCount() << endl;
+}
+
+void BenchmarkNearDuplicates(ostream& out, int document_count) {
+    mt19937 generator(42);
+    auto corpus = GenerateCorpus(generator, document_count, 50, 10000);
+    // Каждый пятый документ — копия одного из предыдущих с одним-двумя лишними словами
+    uniform_int_distribution<int> word_distribution(0, 9999);
+    for (int i = 5; i < document_count; i += 5) {
+        corpus[i] = corpus[uniform_int_distribution<int>(0, i - 1)(generator)];
+        for (int j = 0, extra = 1 + i % 2; j < extra; ++j) {
+            corpus[i].push_back(word_distribution(generator));
+        }
+    }
+    const vector<string> texts = GetCorpusTexts(corpus);
+
+    {
+        SearchServer search_server("and with"s);
+        {
+            LOG_DURATION_STREAM("AddDocument"s, out);
+            for (int document_id = 0; document_id < document_count; ++document_id) {
+                search_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, { 1 });
+            }
+        }
+        vector<int> duplicates;
+        {
+            LOG_DURATION_STREAM("FindDuplicates"s, out);
+            duplicates = FindDuplicates(search_server);
+        }
+        vector<int> near_duplicates;
+        {
+            LOG_DURATION_STREAM("FindNearDuplicates"s, out);
+            near_duplicates = FindNearDuplicates(search_server);
+        }
+        out << "Duplicates: "s << duplicates.size() << ", near duplicates: "s << near_duplicates.size() << endl;
+    }
+    {
+        SearchServer search_server("and with"s);
+        NearDuplicateFilter filter(search_server);
+        size_t rejected = 0;
+        {
+            LOG_DURATION_STREAM("NearDuplicateFilter::AddDocument"s, out);
+            for (int document_id = 0; document_id < document_count; ++document_id) {
+                rejected += filter.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, { 1 }) ? 1 : 0;
+            }
+        }
+        out << "Rejected at ingest: "s << rejected << endl;
+    }
+}
+
+void BenchmarkMatchDocuments(ostream& out, int document_count, int query_count) {
+    CorpusServer fixture(document_count);
+    SearchServer& search_server = fixture.search_server;
+    mt19937& generator = fixture.generator;
+    // Слова запросов встречаются в документах с разной частотой; каждое пятое — минус-слово
+    vector<string> queries;
+    uniform_int_distribution<int> word_distribution(0, 3000);
+    for (int i = 0; i < query_count; ++i) {
+        string query;
+        for (int j = 0; j < 5; ++j) {
+            query += (j == 4 ? "-w"s : "w"s) + to_string(word_distribution(generator)) + " "s;
+        }
+        queries.push_back(move(query));
+    }
+    // Как при подсветке выдачи: 50 лучших документов каждого запроса
+    vector<vector<int>> hits;
+    for (const string& query : queries) {
+        vector<int> document_ids;
+        for (const Document& document : search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 50)) {
+            document_ids.push_back(document.id);
+        }
+        hits.push_back(move(document_ids));
+    }
+
+    size_t words_count = 0;
+    {
+        LOG_DURATION_STREAM("MatchDocument for each document"s, out);
+        for (int i = 0; i < query_count; ++i) {
+            for (const int document_id : hits[i]) {
+                words_count += get<0>(search_server.MatchDocument(queries[i], document_id)).size();
+            }
+        }
+    }
+    size_t batch_words_count = 0;
+    {
+        LOG_DURATION_STREAM("MatchDocuments"s, out);
+        SearchServer::MatchDocumentsResult result;
+        for (int i = 0; i < query_count; ++i) {
+            search_server.MatchDocuments(queries[i], hits[i], result);
+            batch_words_count += result.words.size();
+        }
+    }
+    out << "Matched words: "s << words_count << " (MatchDocuments: "s << batch_words_count << ")"s << endl;
+}
+
+void BenchmarkRequestQueue(ostream& out, int document_count, int request_count) {
+    CorpusServer fixture(document_count);
+    SearchServer& search_server = fixture.search_server;
+    mt19937& generator = fixture.generator;
+    // Каждый третий запрос — из слов, которых нет в индексе
+    vector<string> queries;
+    uniform_int_distribution<int> word_distribution(0, 9999);
+    for (int i = 0; i < 1000; ++i) {
+        const string prefix = i % 3 == 0 ? "x"s : "w"s;
+        queries.push_back(prefix + to_string(word_distribution(generator)) + " "s + prefix
+            + to_string(word_distribution(generator)));
+    }
+
+    {
+        // Прежняя очередь: копии выдач последних запросов в deque
+        LOG_DURATION_STREAM("Deque of result copies, 1 thread"s, out);
+        deque<vector<Document>> requests;
+        int no_result_requests = 0;
+        for (int i = 0; i < request_count; ++i) {
+            requests.push_back(search_server.FindTopDocuments(queries[i % queries.size()]));
+            no_result_requests += requests.back().empty() ? 1 : 0;
+            if (requests.size() > REQUEST_QUEUE_DEFAULT_WINDOW) {
+                no_result_requests -= requests.front().empty() ? 1 : 0;
+                requests.pop_front();
+            }
+        }
+        out << "No result requests: "s << no_result_requests << endl;
+    }
+    {
+        RequestQueue request_queue(search_server);
+        {
+            LOG_DURATION_STREAM("RequestQueue, 1 thread"s, out);
+            for (int i = 0; i < request_count; ++i) {
+                request_queue.AddFindRequest(queries[i % queries.size()]);
+            }
+        }
+        out << "No result requests: "s << request_queue.GetNoResultRequests() << endl;
+    }
+    const unsigned thread_count = max(4u, thread::hardware_concurrency());
+    RequestQueue request_queue(search_server);
+    {
+        LOG_DURATION_STREAM("RequestQueue, "s + to_string(thread_count) + " threads"s, out);
+        vector<thread> threads;
+        for (unsigned t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = static_cast<int>(t); i < request_count; i += static_cast<int>(thread_count)) {
+                    request_queue.AddFindRequest(queries[i % queries.size()]);
+                }
+                });
+        }
+        for (thread& thread : threads) {
+            thread.join();
+        }
+    }
+    const RequestQueue::Stats stats = request_queue.GetStats();
+    out << "Window: "s << stats.request_count << ", no result rate: "s << stats.no_result_rate
+        << ", QPS: "s << static_cast<int64_t>(stats.queries_per_second)
+        << ", p50: "s << stats.latency.GetPercentile(0.5).count() << " ns, p99: "s
+        << stats.latency.GetPercentile(0.99).count() << " ns"s << endl;
+}
+
+namespace {
+
+vector<int> GetDocumentIds(const vector<Document>& documents) {
+    vector<int> ids;
+    for (const Document& document : documents) {
+        ids.push_back(document.id);
+    }
+    return ids;
+}
+
+// Выдачи совпадают вплоть до бит релевантности
+void AssertSameDocuments(const vector<Document>& lhs, const vector<Document>& rhs, const string& hint) {
+    AssertEqual(GetDocumentIds(lhs), GetDocumentIds(rhs), hint);
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        AssertEqual(lhs[i].relevance, rhs[i].relevance, hint);
+        AssertEqual(lhs[i].rating, rhs[i].rating, hint);
+    }
+}
+
+void TestTopDocumentsTieBreakByRating() {
+    TopDocuments top(3);
+    top.Add({ 1, 0.5, 1 });
+    top.Add({ 2, 0.5 + MAX_INACCURACY / 2, 5 });
+    top.Add({ 3, 0.9, 0 });
+    top.Add({ 4, 0.5, 3 });
+    top.Add({ 5, 0.1, 100 });
+    // При равной в пределах MAX_INACCURACY релевантности выше документ с большим рейтингом
+    ASSERT_EQUAL(GetDocumentIds(top.Release()), (vector<int>{ 3, 2, 4 }));
+
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "dog cat"s, DocumentStatus::ACTUAL, { 7 });
+    search_server.AddDocument(3, "cat dog"s, DocumentStatus::ACTUAL, { 4 });
+    search_server.AddDocument(4, "bird"s, DocumentStatus::ACTUAL, { 9 });
+    ASSERT_EQUAL(GetDocumentIds(search_server.FindTopDocuments("cat"s)), (vector<int>{ 2, 3, 1 }));
+    ASSERT_EQUAL(GetDocumentIds(search_server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 2)), (vector<int>{ 2, 3 }));
+}
+
+void TestTopDocumentsHugeTopK() {
+    SearchServer search_server(""s);
+    for (int document_id = 0; document_id < 20; ++document_id) {
+        search_server.AddDocument(document_id, "cat w"s + to_string(document_id), DocumentStatus::ACTUAL, { document_id });
+    }
+    const size_t huge_top_k = numeric_limits<size_t>::max();
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, huge_top_k).size(), 20u);
+    ASSERT_EQUAL(search_server.FindTopDocuments(execution::par, "cat"s, DocumentStatus::ACTUAL, huge_top_k).size(), 20u);
+    ASSERT_EQUAL(search_server.FindTopDocuments(search_policy::max_score, "cat"s, DocumentStatus::ACTUAL, huge_top_k).size(), 20u);
+    TopDocuments top(huge_top_k);
+    top.Add({ 1, 1.0, 1 });
+    ASSERT_EQUAL(top.Release().size(), 1u);
+}
+
+void TestMaxScoreMatchesExhaustiveSearch() {
+    mt19937 generator(7);
+    SearchServer search_server(""s);
+    search_server.SetQueryCacheCapacity(0);
+    // Слово common есть в девяти документах из десяти; рейтинги из узкого диапазона дают много равенств
+    const auto corpus = GenerateCorpus(generator, 3000, 20, 500);
+    uniform_int_distribution<int> rating_distribution(0, 3);
+    for (int document_id = 0; document_id < static_cast<int>(corpus.size()); ++document_id) {
+        const string text = (document_id % 10 != 0 ? "common "s : ""s) + GetCorpusText(corpus[document_id]);
+        search_server.AddDocument(document_id, text, document_id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL,
+            { rating_distribution(generator) });
+    }
+    for (int document_id = 0; document_id < static_cast<int>(corpus.size()); document_id += 7) {
+        search_server.RemoveDocument(document_id);
+    }
+
+    uniform_int_distribution<int> word_distribution(0, 499);
+    for (int i = 0; i < 300; ++i) {
+        string query = i % 2 == 0 ? "common "s : ""s;
+        for (int j = 0; j <= i % 4; ++j) {
+            query += "w"s + to_string(word_distribution(generator)) + " "s;
+        }
+        if (i % 5 == 0) {
+            query += "-w"s + to_string(word_distribution(generator));
+        }
+        for (const size_t top_k : { 1, 5, 50 }) {
+            AssertSameDocuments(search_server.FindTopDocuments(search_policy::max_score, query, DocumentStatus::ACTUAL, top_k),
+                search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, top_k), query);
+        }
+    }
+}
+
+void TestMinusWordsExcludeDocuments() {
+    mt19937 generator(11);
+    SearchServer search_server("and with"s);
+    search_server.SetQueryCacheCapacity(0);
+    const auto corpus = GenerateCorpus(generator, 2000, 15, 300);
+    AddCorpus(search_server, corpus);
+    for (int document_id = 0; document_id < 2000; document_id += 9) {
+        search_server.RemoveDocument(document_id);
+    }
+
+    uniform_int_distribution<int> word_distribution(0, 299);
+    for (int i = 0; i < 100; ++i) {
+        vector<string> plus_words;
+        vector<string> minus_words;
+        for (int j = 0; j < 3; ++j) {
+            plus_words.push_back("w"s + to_string(word_distribution(generator)));
+        }
+        // Частые минус-слова собираются в битовую карту, редкие — в короткий список
+        for (int j = 0; j <= i % 3; ++j) {
+            const int word = i % 2 == 0 ? word_distribution(generator) / 10 : 150 + word_distribution(generator) / 2;
+            minus_words.push_back("w"s + to_string(word));
+        }
+        string query;
+        for (const string& word : plus_words) {
+            query += word + " "s;
+        }
+        for (const string& word : minus_words) {
+            query += "-"s + word + " "s;
+        }
+
+        // Документы с плюс-словом и без минус-слов, найденные перебором
+        set<int> expected;
+        for (const int document_id : search_server) {
+            const auto& word_freqs = search_server.GetWordFrequencies(document_id);
+            const auto has_word = [&word_freqs](const string& word) {
+                return word_freqs.count(word) > 0;
+            };
+            if (any_of(plus_words.begin(), plus_words.end(), has_word) && none_of(minus_words.begin(), minus_words.end(), has_word)) {
+                expected.insert(document_id);
+            }
+        }
+        const size_t all = numeric_limits<size_t>::max();
+        for (const vector<Document>& documents : { search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, all),
+            search_server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, all),
+            search_server.FindTopDocuments(search_policy::max_score, query, DocumentStatus::ACTUAL, all) }) {
+            const vector<int> ids = GetDocumentIds(documents);
+            AssertEqual(set<int>(ids.begin(), ids.end()), expected, query);
+        }
+    }
+}
+
+void TestTermWeightsFollowIndexChanges() {
+    for (const bool frozen : { false, true }) {
+        SearchServer search_server(""s);
+        search_server.FreezeTermWeights(frozen);
+        search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+        search_server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, { 2 });
+        search_server.AddDocument(3, "bird"s, DocumentStatus::ACTUAL, { 3 });
+        search_server.RefreshTermWeights();
+        const string hint = frozen ? "frozen"s : "lazy"s;
+
+        auto documents = search_server.FindTopDocuments("dog"s);
+        ASSERT_EQUAL(documents.size(), 1u);
+        AssertEqual(documents[0].relevance, 0.5 * log(3.0), hint);
+
+        // IDF и верхние оценки следуют за удалением и добавлением документов, замороженные — после RefreshTermWeights
+        search_server.RemoveDocument(3);
+        documents = search_server.FindTopDocuments("dog"s);
+        AssertEqual(documents[0].relevance, 0.5 * log(frozen ? 3.0 : 2.0), hint);
+        search_server.RefreshTermWeights();
+        documents = search_server.FindTopDocuments("dog"s);
+        AssertEqual(documents[0].relevance, 0.5 * log(2.0), hint);
+        search_server.AddDocument(4, "dog dog dog bird"s, DocumentStatus::ACTUAL, { 4 });
+        search_server.RefreshTermWeights();
+        documents = search_server.FindTopDocuments(search_policy::max_score, "dog"s, DocumentStatus::ACTUAL, 1);
+        ASSERT_EQUAL(documents.size(), 1u);
+        AssertEqual(documents[0].id, 4, hint);
+        AssertEqual(documents[0].relevance, 0.75 * log(1.5), hint);
+        // Слово без живых документов ничего не находит
+        search_server.RemoveDocument(4);
+        ASSERT(search_server.FindTopDocuments(search_policy::max_score, "bird"s).empty());
+    }
+}
+
+void TestFrozenTermWeightsBulkAddIsLinear() {
+    // Каждый документ приносит два новых слова: пересчёт всей таблицы IDF на каждый AddDocument
+    // сделал бы добавление квадратичным, и вчетверо больше документов добавлялось бы в 16 раз дольше
+    const auto add_seconds = [](int document_count) {
+        double best = numeric_limits<double>::max();
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            SearchServer search_server(""s);
+            search_server.FreezeTermWeights();
+            const auto start = chrono::steady_clock::now();
+            for (int document_id = 0; document_id < document_count; ++document_id) {
+                search_server.AddDocument(document_id, "common u"s + to_string(document_id) + " v"s + to_string(document_id),
+                    DocumentStatus::ACTUAL, { 1 });
+            }
+            search_server.RefreshTermWeights();
+            const chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+            best = min(best, seconds.count());
+
+            const auto documents = search_server.FindTopDocuments("u7"s);
+            ASSERT_EQUAL(documents.size(), 1u);
+            ASSERT(abs(documents[0].relevance - log(static_cast<double>(document_count)) / 3) < MAX_INACCURACY);
+        }
+        return best;
+    };
+    const double small = add_seconds(10000);
+    const double large = add_seconds(40000);
+    Assert(large < small * 8, to_string(small) + " s for 10000 documents, "s + to_string(large) + " s for 40000"s);
+}
+
+void TestStreamVByteDecodersAgree() {
+    mt19937 generator(3);
+    for (const uint32_t max_value : { 200u, 70000u, 20000000u, UINT32_MAX }) {
+        uniform_int_distribution<uint32_t> value_distribution(0, max_value);
+        vector<uint32_t> values(1024);
+        for (uint32_t& value : values) {
+            value = value_distribution(generator);
+        }
+        vector<uint8_t> encoded;
+        StreamVByteEncode(values.data(), values.size(), encoded);
+        encoded.resize(encoded.size() + STREAM_VBYTE_PADDING);
+        vector<uint32_t> decoded(values.size());
+        vector<uint32_t> decoded_scalar(values.size());
+        ASSERT(StreamVByteDecode(encoded.data(), values.size(), decoded.data())
+            == StreamVByteDecodeScalar(encoded.data(), values.size(), decoded_scalar.data()));
+        ASSERT_EQUAL(decoded, values);
+        ASSERT_EQUAL(decoded_scalar, values);
+
+        sort(values.begin(), values.end());
+        encoded.clear();
+        StreamVByteEncodeDelta(values.data(), values.size(), 0, encoded);
+        encoded.resize(encoded.size() + STREAM_VBYTE_PADDING);
+        StreamVByteDecodeDelta(encoded.data(), values.size(), 0, decoded.data());
+        StreamVByteDecodeDeltaScalar(encoded.data(), values.size(), 0, decoded_scalar.data());
+        ASSERT_EQUAL(decoded, values);
+        ASSERT_EQUAL(decoded_scalar, values);
+    }
+}
+
+void TestQueryCacheEvictsAfterRehash() {
+    // По 4 результата на шард: вытеснение идёт после многих перехеширований индекса шарда
+    const size_t capacity = QUERY_CACHE_SHARD_COUNT * 4;
+    QueryCache cache(capacity);
+    const TermId key_count = 5000;
+    const auto make_key = [](TermId term_id) {
+        return QueryCache::Key{ { term_id }, {}, DocumentStatus::ACTUAL, 5 };
+    };
+    for (TermId term_id = 0; term_id < key_count; ++term_id) {
+        cache.Insert(make_key(term_id), 1, { { static_cast<int>(term_id), 1.0, 0 } });
+    }
+    const QueryCache::Stats stats = cache.GetStats();
+    ASSERT(stats.size <= capacity);
+    ASSERT_EQUAL(stats.evictions + stats.size, static_cast<uint64_t>(key_count));
+
+    size_t found = 0;
+    for (TermId term_id = 0; term_id < key_count; ++term_id) {
+        vector<Document> documents;
+        if (cache.Find(make_key(term_id), 1, documents)) {
+            ASSERT_EQUAL(documents.size(), 1u);
+            ASSERT_EQUAL(documents[0].id, static_cast<int>(term_id));
+            ++found;
+        }
+    }
+    ASSERT_EQUAL(found, stats.size);
+    // Последний добавленный результат ещё не вытеснен
+    vector<Document> documents;
+    ASSERT(cache.Find(make_key(key_count - 1), 1, documents));
+}
+
+void TestQueryCacheSeparatesPolicies() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat and dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "black cat"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "white dog"s, DocumentStatus::ACTUAL, { 3 });
+
+    const auto expected = search_server.FindTopDocuments(execution::seq, "white cat"s);
+    AssertSameDocuments(search_server.FindTopDocuments(execution::par, "white cat"s), expected, "par"s);
+    AssertSameDocuments(search_server.FindTopDocuments(search_policy::max_score, "white cat"s), expected, "max_score"s);
+    // Каждый способ поиска посчитан сам, а не взят из кеша другого
+    QueryCache::Stats stats = search_server.GetQueryCacheStats();
+    ASSERT_EQUAL(stats.hits, 0u);
+    ASSERT_EQUAL(stats.size, 3u);
+
+    search_server.FindTopDocuments(search_policy::max_score, "white cat"s);
+    stats = search_server.GetQueryCacheStats();
+    ASSERT_EQUAL(stats.hits, 1u);
+    ASSERT_EQUAL(stats.size, 3u);
+}
+
+void TestRemovedStatusIsNotTombstone() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::REMOVED, { 1 });
+    search_server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "cat bird"s, DocumentStatus::REMOVED, { 3 });
+    search_server.RemoveDocument(2);
+    search_server.RemoveDocument(3);
+    // Удалённые документы не видны ни под каким статусом, документ со статусом REMOVED виден
+    for (int pass = 0; pass < 2; ++pass) {
+        ASSERT_EQUAL(GetDocumentIds(search_server.FindTopDocuments("cat"s, DocumentStatus::REMOVED)), vector<int>{ 1 });
+        ASSERT(search_server.FindTopDocuments("cat"s).empty());
+        ASSERT_EQUAL(search_server.FindTopDocuments("cat"s, [](int, DocumentStatus, int) { return true; }).size(), 1u);
+        ASSERT(get<1>(search_server.MatchDocument("dog"s, 1)) == DocumentStatus::REMOVED);
+        search_server.CompactIndex();
+    }
+    // Освобождённый номер получает новый документ со своим статусом
+    search_server.AddDocument(4, "cat"s, DocumentStatus::ACTUAL, { 4 });
+    ASSERT_EQUAL(GetDocumentIds(search_server.FindTopDocuments("cat"s)), vector<int>{ 4 });
+    ASSERT_EQUAL(GetDocumentIds(search_server.FindTopDocuments("cat"s, DocumentStatus::REMOVED)), vector<int>{ 1 });
+}
+
+void TestCompactionKeepsResults() {
+    CorpusServer fixture(2000, 30, 2000);
+    SearchServer& search_server = fixture.search_server;
+    search_server.SetQueryCacheCapacity(0);
+    // Каждый пятый документ: меньше порога, при котором уплотнение запускается само
+    set<int> removed_ids;
+    for (int document_id = 0; document_id < 2000; document_id += 5) {
+        search_server.RemoveDocument(document_id);
+        removed_ids.insert(document_id);
+    }
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 1600);
+
+    uniform_int_distribution<int> word_distribution(0, 300);
+    vector<string> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back("w"s + to_string(word_distribution(fixture.generator)) + " w"s
+            + to_string(word_distribution(fixture.generator)) + (i % 3 == 0 ? " -w1"s : ""s));
+    }
+    const auto search = [&search_server](const string& query) {
+        vector<vector<Document>> results;
+        for (const size_t top_k : { 5, 50 }) {
+            results.push_back(search_server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, top_k));
+            results.push_back(search_server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, top_k));
+            results.push_back(search_server.FindTopDocuments(search_policy::max_score, query, DocumentStatus::ACTUAL, top_k));
+        }
+        return results;
+    };
+    vector<vector<vector<Document>>> before;
+    for (const string& query : queries) {
+        before.push_back(search(query));
+        for (const auto& documents : before.back()) {
+            for (const Document& document : documents) {
+                Assert(removed_ids.count(document.id) == 0, query);
+            }
+        }
+    }
+
+    search_server.CompactIndex();
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 1600);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto after = search(queries[i]);
+        ASSERT_EQUAL(after.size(), before[i].size());
+        for (size_t j = 0; j < after.size(); ++j) {
+            AssertSameDocuments(after[j], before[i][j], queries[i]);
+        }
+    }
+}
+
+void TestSnapshotRoundTrip() {
+    const string path = "search_server_test.snapshot"s;
+    CorpusServer fixture(1000, 30, 2000);
+    SearchServer& search_server = fixture.search_server;
+    search_server.AddDocument(1000, "w1 w2 banned"s, DocumentStatus::BANNED, { 5, -1 });
+    for (int document_id = 0; document_id < 1000; document_id += 7) {
+        search_server.RemoveDocument(document_id);
+    }
+    search_server.SaveSnapshot(path);
+
+    {
+        const SearchServer loaded = SearchServer::LoadSnapshot(path);
+        ASSERT_EQUAL(loaded.GetDocumentCount(), search_server.GetDocumentCount());
+        ASSERT_EQUAL(vector<int>(loaded.begin(), loaded.end()), vector<int>(search_server.begin(), search_server.end()));
+        uniform_int_distribution<int> word_distribution(0, 300);
+        for (int i = 0; i < 50; ++i) {
+            const string query = "w"s + to_string(word_distribution(fixture.generator)) + " w"s
+                + to_string(word_distribution(fixture.generator)) + (i % 3 == 0 ? " -w2"s : ""s);
+            AssertSameDocuments(loaded.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+            AssertSameDocuments(loaded.FindTopDocuments(search_policy::max_score, query, DocumentStatus::ACTUAL, 20),
+                search_server.FindTopDocuments(search_policy::max_score, query, DocumentStatus::ACTUAL, 20), query);
+        }
+        AssertSameDocuments(loaded.FindTopDocuments("banned"s, DocumentStatus::BANNED),
+            search_server.FindTopDocuments("banned"s, DocumentStatus::BANNED), "banned"s);
+        for (const int document_id : { 1, 500, 1000 }) {
+            ASSERT_EQUAL(loaded.GetWordFrequencies(document_id), search_server.GetWordFrequencies(document_id));
+        }
+
+        // Сохранение поверх отображённого файла его не портит
+        loaded.SaveSnapshot(path);
+        AssertSameDocuments(loaded.FindTopDocuments("w3 w4"s), search_server.FindTopDocuments("w3 w4"s), "w3 w4"s);
+        ASSERT_EQUAL(loaded.GetWordFrequencies(2), search_server.GetWordFrequencies(2));
+    }
+
+    // Изменения сервера из снимка не расходятся с изменениями исходного
+    {
+        SearchServer loaded = SearchServer::LoadSnapshot(path);
+        ASSERT_EQUAL(loaded.GetWordFrequencies(1), search_server.GetWordFrequencies(1));
+        for (SearchServer* server : { &loaded, &search_server }) {
+            server->RemoveDocument(1);
+            server->RemoveDocument(500);
+            server->AddDocument(2000, "w1 w3 w3 fresh"s, DocumentStatus::ACTUAL, { 3 });
+            server->CompactIndex();
+            server->AddDocument(2001, "fresh w2"s, DocumentStatus::ACTUAL, { 4 });
+        }
+        ASSERT_EQUAL(loaded.GetDocumentCount(), search_server.GetDocumentCount());
+        ASSERT_EQUAL(vector<int>(loaded.begin(), loaded.end()), vector<int>(search_server.begin(), search_server.end()));
+        for (const string& query : { "w1 w3"s, "fresh -w2"s, "w2 w5 w7"s }) {
+            AssertSameDocuments(loaded.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+        }
+        for (const int document_id : { 2, 1000, 2000 }) {
+            ASSERT_EQUAL(loaded.GetWordFrequencies(document_id), search_server.GetWordFrequencies(document_id));
+        }
+    }
+
+    // Повреждённый, обрезанный и чужой файлы не загружаются
+    string bytes;
+    {
+        ifstream input(path, ios::binary);
+        bytes.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+    }
+    const auto rejects = [&path](const string& content, bool verify_checksum = true) {
+        {
+            ofstream output(path, ios::binary | ios::trunc);
+            output << content;
+        }
+        try {
+            SearchServer::LoadSnapshot(path, verify_checksum);
+        } catch (const runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    string corrupted = bytes;
+    corrupted[corrupted.size() / 2] ^= 1;
+    ASSERT(rejects(corrupted));
+    ASSERT(rejects(bytes.substr(0, bytes.size() - 1)));
+    corrupted = bytes;
+    corrupted[0] ^= 1;
+    ASSERT(rejects(corrupted));
+    ASSERT(!rejects(bytes));
+
+    // Номера и смещения проверяются и без контрольной суммы. Оглавление идёт после
+    // сигнатуры, версии, порядка байт, размера файла и контрольной суммы
+    const auto section_offset = [&bytes](SnapshotSection section) {
+        SnapshotRange range;
+        memcpy(&range, bytes.data() + 32 + sizeof(SnapshotRange) * static_cast<size_t>(section), sizeof(range));
+        ASSERT(range.size > 0);
+        return range.offset;
+    };
+    for (const SnapshotSection section : { SnapshotSection::REMOVED_ORDINALS, SnapshotSection::DOCUMENT_ORDINALS,
+        SnapshotSection::FORWARD_TERMS, SnapshotSection::TERM_OFFSETS, SnapshotSection::BLOCKS }) {
+        corrupted = bytes;
+        const int32_t huge = 0x7fffffff;
+        memcpy(corrupted.data() + section_offset(section), &huge, sizeof(huge));
+        ASSERT(rejects(corrupted, false));
+    }
+    ASSERT(!rejects(bytes, false));
+    remove(path.c_str());
+}
+
+void TestSegmentedIndexViewIsStable() {
+    mt19937 generator(42);
+    const vector<string> texts = GetCorpusTexts(GenerateCorpus(generator, 1000, 30, 2000));
+    vector<string> queries;
+    uniform_int_distribution<int> word_distribution(0, 300);
+    for (int i = 0; i < 20; ++i) {
+        queries.push_back("w"s + to_string(word_distribution(generator)) + " w"s + to_string(word_distribution(generator))
+            + " -w"s + to_string(word_distribution(generator)));
+    }
+
+    // Маленький изменяемый сегмент, чтобы представления публиковались часто и шли слияния
+    SegmentedIndex index("and with"s, 64);
+    for (int document_id = 0; document_id < 500; ++document_id) {
+        index.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, { document_id % 100 });
+    }
+    index.Flush();
+    const shared_ptr<const SegmentedIndex::View> view = index.GetView();
+    ASSERT_EQUAL(view->GetDocumentCount(), 500);
+    vector<vector<Document>> expected;
+    for (const string& query : queries) {
+        expected.push_back(view->FindTopDocuments(query));
+    }
+
+    // Писатель добавляет и удаляет документы, читатель тем временем ищет в старом и в новых представлениях
+    atomic<bool> done = false;
+    atomic<int> started_count = 500;
+    size_t inconsistency_count = 0;
+    thread writer([&] {
+        for (int document_id = 500; document_id < 1000; ++document_id) {
+            ++started_count;
+            index.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, { document_id % 100 });
+            if (document_id % 5 == 4) {
+                index.RemoveDocument(document_id / 2);
+            }
+        }
+        index.Flush();
+        done.store(true);
+    });
+    const auto same = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+        return GetDocumentIds(lhs) == GetDocumentIds(rhs) && equal(lhs.begin(), lhs.end(), rhs.begin(),
+            [](const Document& l, const Document& r) { return l.relevance == r.relevance && l.rating == r.rating; });
+    };
+    for (size_t i = 0; !done.load() || i < queries.size(); ++i) {
+        const size_t query_index = i % queries.size();
+        inconsistency_count += same(view->FindTopDocuments(queries[query_index]), expected[query_index]) ? 0 : 1;
+        const shared_ptr<const SegmentedIndex::View> current = index.GetView();
+        inconsistency_count += current->GetDocumentCount() <= started_count.load() ? 0 : 1;
+        inconsistency_count += same(current->FindTopDocuments(queries[query_index]),
+            current->FindTopDocuments(queries[query_index])) ? 0 : 1;
+    }
+    writer.join();
+    index.WaitForMerges();
+    ASSERT_EQUAL(inconsistency_count, 0u);
+    ASSERT_EQUAL(view->GetDocumentCount(), 500);
+    ASSERT_EQUAL(index.GetView()->GetDocumentCount(), 900);
+    // Старое представление пережило слияния и удаления без изменений
+    for (size_t i = 0; i < queries.size(); ++i) {
+        Assert(same(view->FindTopDocuments(queries[i]), expected[i]), queries[i]);
+    }
+}
+
+void TestSegmentedIndexMatchesSearchServer() {
+    mt19937 generator(7);
+    const vector<string> texts = GetCorpusTexts(GenerateCorpus(generator, 1200, 30, 2000));
+    vector<string> queries;
+    uniform_int_distribution<int> word_distribution(0, 400);
+    for (int i = 0; i < 60; ++i) {
+        queries.push_back("w"s + to_string(word_distribution(generator)) + " w"s + to_string(word_distribution(generator))
+            + " w"s + to_string(word_distribution(generator)) + (i % 2 == 0 ? " -w"s + to_string(word_distribution(generator)) : ""s));
+    }
+
+    // Рейтинг равен id, чтобы порядок равных по релевантности документов не зависел от сегментов
+    SearchServer search_server("and with"s);
+    SegmentedIndex index("and with"s, 64);
+    const auto add = [&](int document_id, const string& text) {
+        const DocumentStatus status = document_id % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        search_server.AddDocument(document_id, text, status, { document_id });
+        index.AddDocument(document_id, text, status, { document_id });
+    };
+    const auto assert_same = [&](const string& stage) {
+        const shared_ptr<const SegmentedIndex::View> view = index.GetView();
+        ASSERT_EQUAL(index.GetDocumentCount(), search_server.GetDocumentCount());
+        ASSERT_EQUAL(view->GetDocumentCount(), search_server.GetDocumentCount());
+        for (const string& query : queries) {
+            const vector<Document> expected = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 50);
+            AssertSameDocuments(index.FindTopDocuments(query, DocumentStatus::ACTUAL, 50), expected, stage + ": "s + query);
+            AssertSameDocuments(view->FindTopDocuments(query, DocumentStatus::ACTUAL, 50), expected, stage + ": "s + query);
+            AssertSameDocuments(index.FindTopDocuments(query, DocumentStatus::BANNED),
+                search_server.FindTopDocuments(query, DocumentStatus::BANNED), stage + ": "s + query);
+        }
+    };
+
+    for (int document_id = 0; document_id < 1000; ++document_id) {
+        add(document_id, texts[document_id]);
+    }
+    index.Flush();
+    assert_same("added"s);
+
+    // Удаления из запечатанных и изменяемых сегментов; новые документы не приносят новых слов,
+    // поэтому номера слов в обоих индексах выдаются одинаково
+    for (int document_id = 0; document_id < 1000; document_id += 3) {
+        search_server.RemoveDocument(document_id);
+        index.RemoveDocument(document_id);
+    }
+    for (int document_id = 1000; document_id < 1200; ++document_id) {
+        add(document_id, texts[document_id % 1000 / 3 * 3 + 1]);
+        if (document_id % 4 == 0) {
+            search_server.RemoveDocument(document_id - 1);
+            index.RemoveDocument(document_id - 1);
+        }
+    }
+    index.Flush();
+    assert_same("removed"s);
+
+    index.WaitForMerges();
+    assert_same("merged"s);
+}
+
+void TestConcurrentIngestMatchesSequential() {
+    mt19937 generator(42);
+    const int document_count = 2000;
+    const vector<string> texts = GetCorpusTexts(GenerateCorpus(generator, document_count, 30, 2000));
+    // Рейтинг равен id, чтобы порядок равных по релевантности документов не зависел от сегментов
+    SegmentedIndex sequential("and with"s, 128);
+    for (int document_id = 0; document_id < document_count; ++document_id) {
+        sequential.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, { document_id });
+    }
+    SegmentedIndex concurrent("and with"s, 128);
+    const unsigned thread_count = 4;
+    atomic<int> added_count = 0;
+    atomic<int> rejected_count = 0;
+    // Каждый документ добавляют два потока: успешен ровно один
+    RunThreads(thread_count, [&](unsigned thread_index) {
+        for (int document_id = thread_index / 2; document_id < document_count; document_id += thread_count / 2) {
+            try {
+                concurrent.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, { document_id });
+                ++added_count;
+            } catch (const invalid_argument&) {
+                ++rejected_count;
+            }
+        }
+    });
+    ASSERT_EQUAL(added_count.load(), document_count);
+    ASSERT_EQUAL(rejected_count.load(), document_count);
+    for (SegmentedIndex* index : { &sequential, &concurrent }) {
+        index->Flush();
+        index->WaitForMerges();
+    }
+    ASSERT_EQUAL(concurrent.GetDocumentCount(), sequential.GetDocumentCount());
+
+    uniform_int_distribution<int> word_distribution(0, 300);
+    for (int i = 0; i < 100; ++i) {
+        const string query = "w"s + to_string(word_distribution(generator)) + " w"s + to_string(word_distribution(generator))
+            + (i % 3 == 0 ? " -w"s + to_string(word_distribution(generator)) : ""s);
+        AssertSameDocuments(concurrent.FindTopDocuments(query, DocumentStatus::ACTUAL, 20),
+            sequential.FindTopDocuments(query, DocumentStatus::ACTUAL, 20), query);
+    }
+}
+
+void TestQueryExecutorHonorsTopK() {
+    CorpusServer fixture(1000, 30, 2000);
+    const SearchServer& search_server = fixture.search_server;
+    vector<string> queries;
+    uniform_int_distribution<int> word_distribution(0, 100);
+    for (int i = 0; i < 50; ++i) {
+        queries.push_back("w"s + to_string(word_distribution(fixture.generator)) + " w"s
+            + to_string(word_distribution(fixture.generator)));
+    }
+    QueryExecutor executor(2);
+    for (const size_t top_k : { 1, 5, 20 }) {
+        const QueryResults results = ProcessQueries(executor, search_server, queries, top_k);
+        auto futures = executor.SubmitQueries(search_server, queries, top_k);
+        ASSERT_EQUAL(results.size(), queries.size());
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto expected = search_server.FindTopDocuments(queries[i], DocumentStatus::ACTUAL, top_k);
+            ASSERT_EQUAL(expected.size(), top_k);
+            AssertSameDocuments(vector<Document>(results[i].begin(), results[i].end()), expected, queries[i]);
+            AssertSameDocuments(futures[i].get(), expected, queries[i]);
+        }
+    }
+    // Запросы выполняются параллельно, но документы идут в порядке запросов
+    vector<Document> expected;
+    for (const string& query : queries) {
+        const auto documents = search_server.FindTopDocuments(query);
+        expected.insert(expected.end(), documents.begin(), documents.end());
+    }
+    AssertSameDocuments(ProcessQueriesJoined(search_server, queries), expected, "ProcessQueriesJoined"s);
+}
+
+void TestBatchSearchMatchesFindTopDocuments() {
+    CorpusServer fixture(1000, 30, 2000);
+    SearchServer& search_server = fixture.search_server;
+    for (int document_id = 0; document_id < 1000; document_id += 9) {
+        search_server.RemoveDocument(document_id);
+    }
+    vector<string> queries;
+    uniform_int_distribution<int> word_distribution(0, 200);
+    for (int i = 0; i < 60; ++i) {
+        string query = "w"s + to_string(word_distribution(fixture.generator)) + " w"s + to_string(word_distribution(fixture.generator));
+        if (i % 3 == 0) {
+            query += " -w"s + to_string(word_distribution(fixture.generator));
+        }
+        queries.push_back(move(query));
+    }
+    // Повтор запроса, пустая выдача (неизвестное слово, только минус-слова, только стоп-слова)
+    // и запрос, минус-слово которого исключает все его документы
+    queries.push_back(queries[1]);
+    queries.push_back("unknown"s);
+    queries.push_back("-w1 -w2"s);
+    queries.push_back("and with"s);
+    queries.push_back("w5 -w5"s);
+
+    for (const size_t top_k : { 1, 5, 30 }) {
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            const vector<vector<Document>> results = search_server.FindTopDocumentsBatch(queries, status, top_k);
+            ASSERT_EQUAL(results.size(), queries.size());
+            for (size_t i = 0; i < queries.size(); ++i) {
+                AssertSameDocuments(results[i], search_server.FindTopDocuments(queries[i], status, top_k), queries[i]);
+            }
+        }
+    }
+    const auto even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+    const vector<vector<Document>> results = search_server.FindTopDocumentsBatch(queries, even);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        AssertSameDocuments(results[i], search_server.FindTopDocuments(queries[i], even), queries[i]);
+    }
+    for (size_t i = queries.size() - 4; i < queries.size(); ++i) {
+        ASSERT(results[i].empty());
+    }
+
+    // Недопустимый запрос отвергается, как и у FindTopDocuments
+    queries.push_back("w1 --w2"s);
+    bool rejected = false;
+    try {
+        search_server.FindTopDocumentsBatch(queries);
+    } catch (const invalid_argument&) {
+        rejected = true;
+    }
+    ASSERT(rejected);
+}
+
+void TestFindDuplicatesMatchesWordSets() {
+    mt19937 generator(42);
+    auto corpus = GenerateCorpus(generator, 1000, 10, 300);
+    // Копии с переставленными и повторёнными словами — дубликаты, копии без одного слова — нет
+    for (int i = 5; i < 1000; i += 5) {
+        corpus[i] = corpus[uniform_int_distribution<int>(0, i - 1)(generator)];
+        shuffle(corpus[i].begin(), corpus[i].end(), generator);
+        if (i % 2 == 0) {
+            corpus[i].push_back(corpus[i].front());
+        }
+        else if (i % 3 == 0) {
+            corpus[i].pop_back();
+        }
+    }
+    SearchServer search_server("and with"s);
+    AddCorpus(search_server, corpus);
+    search_server.AddDocument(1000, "w1 and w2 with"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(1001, "w2 w1"s, DocumentStatus::ACTUAL, { 1 });
+    for (int document_id = 0; document_id < 1000; document_id += 7) {
+        search_server.RemoveDocument(document_id);
+    }
+
+    vector<int> expected;
+    set<set<string, less<>>> word_sets;
+    for (const int document_id : search_server) {
+        set<string, less<>> words;
+        for (const auto& [word, freq] : search_server.GetWordFrequencies(document_id)) {
+            words.emplace(word);
+        }
+        if (!word_sets.insert(move(words)).second) {
+            expected.push_back(document_id);
+        }
+    }
+    ASSERT(!expected.empty());
+    ASSERT_EQUAL(FindDuplicates(search_server), expected);
+    ASSERT_EQUAL(RemoveDuplicates(search_server), expected);
+    ASSERT(FindDuplicates(search_server).empty());
+}
+
+void TestNearDuplicatesMatchBruteForce() {
+    mt19937 generator(3);
+    uniform_int_distribution<int> word_distribution(0, 2000);
+    // Каждый третий документ — копия одного из предыдущих с лишними словами и, возможно, без первого слова;
+    // каждый седьмой собран из сорока частых слов, чтобы были пары со средним сходством
+    vector<vector<int>> corpus;
+    for (int document_id = 0; document_id < 1500; ++document_id) {
+        vector<int> document;
+        if (document_id > 10 && document_id % 3 == 0) {
+            document = corpus[uniform_int_distribution<int>(0, document_id - 1)(generator)];
+            for (int i = 0; i < document_id % 4; ++i) {
+                document.push_back(word_distribution(generator));
+            }
+            if (document_id % 2 != 0) {
+                document.erase(document.begin());
+            }
+        }
+        else {
+            for (int i = 0; i < 20; ++i) {
+                document.push_back(word_distribution(generator) % (document_id % 7 == 0 ? 40 : 2000));
+            }
+        }
+        corpus.push_back(move(document));
+    }
+    SearchServer search_server("and with"s);
+    AddCorpus(search_server, corpus);
+
+    const auto jaccard = [&search_server](int lhs_id, int rhs_id) {
+        const auto& lhs = search_server.GetWordFrequencies(lhs_id);
+        const auto& rhs = search_server.GetWordFrequencies(rhs_id);
+        size_t common = 0;
+        for (const auto& [word, freq] : lhs) {
+            common += rhs.count(word);
+        }
+        const size_t united = lhs.size() + rhs.size() - common;
+        return united == 0 ? 1.0 : static_cast<double>(common) / united;
+    };
+    for (const double threshold : { 0.5, 0.8, 1.0 }) {
+        // Перебор: документ — почти дубликат, если похож на один из оставленных документов с меньшим id
+        vector<int> kept;
+        vector<int> expected;
+        for (const int document_id : search_server) {
+            if (any_of(kept.begin(), kept.end(), [&](int kept_id) { return jaccard(document_id, kept_id) >= threshold; })) {
+                expected.push_back(document_id);
+            }
+            else {
+                kept.push_back(document_id);
+            }
+        }
+        ASSERT(!expected.empty());
+        Assert(FindNearDuplicates(search_server, threshold) == expected, to_string(threshold));
+    }
+    ASSERT_EQUAL(FindNearDuplicates(search_server, 1.0), FindDuplicates(search_server));
+
+    // Фильтр при загрузке отбрасывает те же документы
+    SearchServer filtered_server("and with"s);
+    NearDuplicateFilter filter(filtered_server);
+    vector<int> rejected;
+    for (int document_id = 0; document_id < static_cast<int>(corpus.size()); ++document_id) {
+        if (filter.AddDocument(document_id, GetCorpusText(corpus[document_id]), DocumentStatus::ACTUAL, { 1 })) {
+            rejected.push_back(document_id);
+        }
+    }
+    ASSERT_EQUAL(rejected, FindNearDuplicates(search_server));
+    ASSERT_EQUAL(filtered_server.GetDocumentCount(), static_cast<int>(corpus.size() - rejected.size()));
+}
+
+void TestMatchDocumentsMatchesMatchDocument() {
+    mt19937 generator(5);
+    uniform_int_distribution<int> word_distribution(0, 80);
+    for (const bool compressed : { false, true }) {
+        // w3 — стоп-слово; статусы документов чередуются
+        SearchServer search_server("and with w3"s);
+        for (int document_id = 0; document_id < 400; ++document_id) {
+            string text;
+            for (int i = 0; i < 1 + document_id % 12; ++i) {
+                text += "w"s + to_string(word_distribution(generator) * word_distribution(generator) / 80) + " "s;
+            }
+            search_server.AddDocument(document_id, text, static_cast<DocumentStatus>(document_id % 4), { 1 });
+        }
+        for (int document_id = 0; document_id < 400; document_id += 7) {
+            search_server.RemoveDocument(document_id);
+        }
+        if (compressed) {
+            search_server.CompressPostings();
+        }
+        vector<int> document_ids(search_server.begin(), search_server.end());
+        shuffle(document_ids.begin(), document_ids.end(), generator);
+        document_ids.resize(50);
+
+        // Один буфер на все запросы
+        SearchServer::MatchDocumentsResult result;
+        for (int query_index = 0; query_index < 100; ++query_index) {
+            string query;
+            for (int i = 0; i < query_index % 6; ++i) {
+                query += (i == 4 ? "-w"s : "w"s) + to_string(word_distribution(generator)) + " "s;
+            }
+            query += "missing w3"s;
+            search_server.MatchDocuments(query, document_ids, result);
+            ASSERT_EQUAL(result.size(), document_ids.size());
+            for (size_t i = 0; i < document_ids.size(); ++i) {
+                const auto [words, status] = search_server.MatchDocument(query, document_ids[i]);
+                auto matched = result[i];
+                Assert(status == result.statuses[i], query);
+                Assert(equal(matched.begin(), matched.end(), words.begin(), words.end()), query);
+            }
+        }
+        try {
+            search_server.MatchDocuments("w1"s, { 0 }, result);
+            Assert(false, "MatchDocuments must throw for a removed document"s);
+        } catch (const out_of_range&) {
+        }
+    }
+}
+
+void TestRequestQueueMatchesDeque() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "big dog"s, DocumentStatus::ACTUAL, { 2 });
+    const vector<string> queries = { "cat"s, "parrot"s, "dog"s, "fish"s, "bird"s };
+    // Окно прежней очереди: выдачи последних window_size запросов
+    const size_t window_size = 7;
+    RequestQueue request_queue(search_server, window_size);
+    deque<bool> empty_results;
+    for (int i = 0; i < 40; ++i) {
+        const string& query = queries[(i * i + i / 3) % queries.size()];
+        empty_results.push_back(request_queue.AddFindRequest(query).empty());
+        if (empty_results.size() > window_size) {
+            empty_results.pop_front();
+        }
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), static_cast<int>(count(empty_results.begin(), empty_results.end(), true)));
+        const RequestQueue::Stats stats = request_queue.GetStats();
+        ASSERT_EQUAL(stats.request_count, empty_results.size());
+        ASSERT_EQUAL(stats.latency.GetCount(), static_cast<uint64_t>(empty_results.size()));
+    }
+}
+
+void TestRequestQueueConcurrentWindow() {
+    SearchServer search_server("and with"s);
+    const size_t window_size = 100;
+    RequestQueue request_queue(search_server, window_size);
+    const unsigned thread_count = 4;
+    atomic<bool> done = false;
+    size_t invalid_stats_count = 0;
+    // Статистика читается во время записи: окно не больше заданного, QPS не отрицательный
+    thread reader([&] {
+        while (!done.load()) {
+            const RequestQueue::Stats stats = request_queue.GetStats();
+            if (stats.request_count > window_size || stats.no_result_count > window_size + thread_count
+                || !(stats.queries_per_second >= 0.0) || stats.queries_per_second == numeric_limits<double>::infinity()) {
+                ++invalid_stats_count;
+            }
+        }
+    });
+    // Сначала окно заполняется пустыми выдачами, затем целиком вытесняется непустыми
+    for (const size_t hit_count : { 0, 1 }) {
+        RunThreads(thread_count, [&](unsigned) {
+            for (size_t i = 0; i < window_size; ++i) {
+                request_queue.AddRequest(hit_count, chrono::microseconds(1 + i % 10));
+            }
+        });
+        const RequestQueue::Stats stats = request_queue.GetStats();
+        ASSERT_EQUAL(stats.request_count, window_size);
+        ASSERT_EQUAL(stats.no_result_count, hit_count == 0 ? window_size : 0u);
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), hit_count == 0 ? static_cast<int>(window_size) : 0);
+        ASSERT_EQUAL(stats.latency.GetCount(), static_cast<uint64_t>(window_size));
+        ASSERT(stats.latency.GetPercentile(0.0) >= chrono::microseconds(1));
+        ASSERT(stats.latency.GetPercentile(1.0) <= chrono::microseconds(10) * 9 / 8);
+        ASSERT(stats.queries_per_second > 0.0);
+    }
+    done.store(true);
+    reader.join();
+    ASSERT_EQUAL(invalid_stats_count, 0u);
+}
+
+// Ключи k и k + 1, k + 2, k + 3 (k кратно 4) и ещё семь таких же четвёрок дают один хеш:
+// длинные цепочки в одном шарде, на которых работает удаление со сдвигом назад
+struct CollidingHash {
+    size_t operator()(int key) const {
+        return static_cast<size_t>(key / 4 % 8);
+    }
+};
+
+void TestConcurrentMapMatchesMap() {
+    const unsigned thread_count = 4;
+    const int operation_count = 20000;
+    const int shared_key_count = 10;
+    ConcurrentMap<int, int, CollidingHash> concurrent_map(4);
+    // Поток t увеличивает и удаляет ключи вида t + 4 * i; общие ключи от 1000 все потоки только увеличивают
+    const auto run = [&](unsigned thread_index, const auto& increment, const auto& erase) {
+        mt19937 generator(thread_index);
+        for (int i = 0; i < operation_count; ++i) {
+            const int key = static_cast<int>(thread_index) + 4 * static_cast<int>(generator() % 64);
+            if (generator() % 3 == 0) {
+                erase(key);
+            }
+            else {
+                increment(key);
+            }
+            increment(1000 + i % shared_key_count);
+        }
+    };
+    RunThreads(thread_count, [&](unsigned thread_index) {
+        run(thread_index,
+            [&concurrent_map](int key) { ++concurrent_map[key].ref_to_value; },
+            [&concurrent_map](int key) { concurrent_map.erase(key); });
+    });
+
+    map<int, int> expected;
+    for (unsigned thread_index = 0; thread_index < thread_count; ++thread_index) {
+        run(thread_index,
+            [&expected](int key) { ++expected[key]; },
+            [&expected](int key) { expected.erase(key); });
+    }
+    ASSERT_EQUAL(concurrent_map.BuildOrdinaryMap(), expected);
+    ASSERT_EQUAL(concurrent_map.size(), expected.size());
+    int64_t sum = 0;
+    concurrent_map.ForEach([&sum](const int, int& value) {
+        sum += value;
+    });
+    int64_t expected_sum = 0;
+    for (const auto& [key, value] : expected) {
+        expected_sum += value;
+    }
+    ASSERT_EQUAL(sum, expected_sum);
+
+    // Удаление несуществующего ключа из цепочки ничего не портит
+    ASSERT(!concurrent_map.erase(4 * 64 * 8));
+    map<int, int> drained;
+    concurrent_map.Drain([&drained](int key, int value) {
+        drained.emplace(key, value);
+    });
+    ASSERT_EQUAL(drained, expected);
+    ASSERT_EQUAL(concurrent_map.size(), 0u);
+    ASSERT(concurrent_map.BuildOrdinaryMap().empty());
+}
+
+void TestSplitIntoValidWordsMatchesScalar() {
+    const auto check = [](const string& text) {
+        const vector<string_view> expected = SplitIntoWordsView(text);
+        const bool valid = all_of(expected.begin(), expected.end(), SearchServer::IsValidWord);
+        vector<string_view> words{ "stale"sv };
+        Assert(SplitIntoValidWords(text, words) == valid, "validity of "s + to_string(text.size()) + "-byte text"s);
+        if (valid) {
+            Assert(words == expected, text);
+        }
+        // Поиск и добавление бросают на тех же текстах
+        SearchServer search_server(""s);
+        bool add_thrown = false;
+        try {
+            search_server.AddDocument(1, text, DocumentStatus::ACTUAL, { 1 });
+        } catch (const invalid_argument&) {
+            add_thrown = true;
+        }
+        bool find_thrown = false;
+        try {
+            search_server.FindTopDocuments(text);
+        } catch (const invalid_argument&) {
+            find_thrown = true;
+        }
+        ASSERT_EQUAL(add_thrown, !valid);
+        ASSERT_EQUAL(find_thrown, !valid);
+    };
+
+    // Серии пробелов, байты старше 127 (отрицательный char) и 127 допустимы
+    const string alphabet = "ab  \x7f\xd0\x96"s;
+    mt19937 generator(10);
+    for (size_t size = 0; size <= 100; ++size) {
+        string text(size, ' ');
+        for (int round = 0; round < 5; ++round) {
+            for (char& c : text) {
+                c = alphabet[generator() % alphabet.size()];
+            }
+            check(text);
+        }
+    }
+    // Управляющий символ на каждой позиции, в том числе у границ блоков по 16 и 32 байта и в хвосте
+    for (const size_t size : { 1, 7, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 100 }) {
+        for (size_t position = 0; position < size; ++position) {
+            for (const char control : { '\0', '\t', '\n', '\x1f' }) {
+                string text(size, 'w');
+                for (size_t i = 3; i < size; i += 5) {
+                    text[i] = ' ';
+                }
+                text[position] = control;
+                check(text);
+            }
+        }
+    }
+    check(string(64, ' '));
+    check(string(65, 'x'));
+}
+
+SearchServer MakeMovedServer() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat and dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "black cat"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "white parrot"s, DocumentStatus::BANNED, { 3 });
+    // Кеш и веса слов заполнены до перемещения
+    search_server.FindTopDocuments("white cat"s);
+    return search_server;
+}
+
+void TestSearchServerIsMovable() {
+    const SearchServer reference = MakeMovedServer();
+    const auto expected = reference.FindTopDocuments("white cat -dog"s);
+    const auto [expected_words, expected_status] = reference.MatchDocument("white cat"s, 1);
+
+    vector<SearchServer> servers;
+    for (int i = 0; i < 10; ++i) {
+        // Перевыделение вектора перемещает серверы
+        servers.push_back(MakeMovedServer());
+    }
+    const auto [words, status] = servers[0].MatchDocument("white cat"s, 1);
+    servers.push_back(MakeMovedServer());
+    for (SearchServer& search_server : servers) {
+        AssertSameDocuments(search_server.FindTopDocuments("white cat -dog"s), expected, "moved"s);
+        AssertSameDocuments(search_server.FindTopDocuments(search_policy::max_score, "white cat -dog"s), expected, "moved"s);
+        search_server.AddDocument(4, "white cat"s, DocumentStatus::ACTUAL, { 4 });
+        ASSERT_EQUAL(search_server.FindTopDocuments("white cat"s).size(), 3u);
+        search_server.RemoveDocument(4);
+        AssertSameDocuments(search_server.FindTopDocuments("white cat -dog"s), expected, "after changes"s);
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+    }
+    // Слова, выданные до перемещений, указывают в словарь, который переехал вместе с сервером
+    ASSERT_EQUAL(words, expected_words);
+    ASSERT(status == expected_status);
+}
+
+void TestRelocatedTermsKeepIssuedWords() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(0, "kept alpha and beta"s, DocumentStatus::ACTUAL, { 1 });
+    // Длинные уникальные слова занимают несколько блоков арены и после удаления становятся мёртвыми байтами
+    const int churn_count = 20000;
+    for (int document_id = 1; document_id <= churn_count; ++document_id) {
+        search_server.AddDocument(document_id, "transient_word_number_"s + to_string(document_id) + " alpha"s,
+            DocumentStatus::ACTUAL, { 1 });
+    }
+    const auto [matched_words, status] = search_server.MatchDocument("alpha beta kept missing"s, 0);
+    const map<string_view, double>& word_freqs = search_server.GetWordFrequencies(0);
+    const vector<string_view> frequency_words = [&word_freqs] {
+        vector<string_view> words;
+        for (const auto& [word, freq] : word_freqs) {
+            words.push_back(word);
+        }
+        return words;
+    }();
+    const vector<string> expected_words = { "alpha"s, "beta"s, "kept"s };
+    ASSERT_EQUAL(vector<string>(matched_words.begin(), matched_words.end()), expected_words);
+    ASSERT_EQUAL(vector<string>(frequency_words.begin(), frequency_words.end()), expected_words);
+
+    // Удаления запускают уплотнение индекса, а оно — перенос слов в новую арену
+    const size_t storage_before = search_server.GetTermStorageSize();
+    for (int document_id = 1; document_id <= churn_count; ++document_id) {
+        search_server.RemoveDocument(document_id);
+    }
+    // Новые документы занимают память, освобождённую при уплотнении
+    for (int document_id = 1; document_id <= churn_count / 2; ++document_id) {
+        search_server.AddDocument(churn_count + document_id, "refill_word_"s + to_string(document_id) + " padding"s,
+            DocumentStatus::ACTUAL, { 1 });
+    }
+    ASSERT_EQUAL(vector<string>(matched_words.begin(), matched_words.end()), expected_words);
+    ASSERT_EQUAL(vector<string>(frequency_words.begin(), frequency_words.end()), expected_words);
+    ASSERT(status == DocumentStatus::ACTUAL);
+    // Ключи словаря частот уже перенесены в новую арену
+    vector<string> current_words;
+    for (const auto& [word, freq] : search_server.GetWordFrequencies(0)) {
+        current_words.emplace_back(word);
+        Assert(find(frequency_words.begin(), frequency_words.end(), word) != frequency_words.end(), "same words"s);
+    }
+    ASSERT_EQUAL(current_words, expected_words);
+    ASSERT(search_server.GetWordFrequencies(0).begin()->first.data() != frequency_words.front().data());
+
+    const size_t released = search_server.ReleaseRetiredTerms();
+    ASSERT(released >= storage_before);
+    ASSERT_EQUAL(search_server.ReleaseRetiredTerms(), 0u);
+    ASSERT(search_server.GetTermStorageSize() < storage_before);
+    ASSERT_EQUAL(search_server.FindTopDocuments("alpha kept"s).size(), 1u);
+}
+
+void TestAddDocumentsMatchesAddDocument() {
+    mt19937 generator(15);
+    const vector<string> texts = GetCorpusTexts(GenerateCorpus(generator, 3000, 20, 3000));
+    vector<DocumentToAdd> documents;
+    for (int document_id = 0; document_id < 3000; ++document_id) {
+        documents.push_back({ document_id + 100, texts[document_id], static_cast<DocumentStatus>(document_id % 4),
+            { document_id % 7, -(document_id % 3) } });
+    }
+    // Ошибки: отрицательный id, id из индекса, повтор id в пакете, управляющий символ; а также
+    // документ из одних стоп-слов и пустой документ
+    documents[10].id = -1;
+    documents[20].id = 5;
+    documents[30].id = documents[29].id;
+    documents[40].text = "w1 bad\x01word w2"sv;
+    documents[50].text = "and with"sv;
+    documents[60].text = ""sv;
+
+    const auto prepare = [](SearchServer& search_server) {
+        search_server.SetQueryCacheCapacity(0);
+        // Удалённые документы освобождают внутренние номера, которые пакет переиспользует
+        for (int document_id = 0; document_id < 10; ++document_id) {
+            search_server.AddDocument(document_id, "w1 w2 seed"s + to_string(document_id), DocumentStatus::ACTUAL, { 1 });
+        }
+        search_server.RemoveDocuments({ 1, 2, 3, 7 });
+    };
+    SearchServer one_by_one("and with"s);
+    prepare(one_by_one);
+    vector<AddDocumentError> expected_errors;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const DocumentToAdd& document = documents[i];
+        try {
+            one_by_one.AddDocument(document.id, document.text, document.status, document.ratings);
+        } catch (const invalid_argument& error) {
+            expected_errors.push_back({ i, document.id, error.what() });
+        }
+    }
+    ASSERT_EQUAL(expected_errors.size(), 4u);
+
+    vector<string> queries;
+    uniform_int_distribution<int> word_distribution(0, 200);
+    for (int i = 0; i < 50; ++i) {
+        queries.push_back("w"s + to_string(word_distribution(generator)) + " w"s + to_string(word_distribution(generator))
+            + (i % 4 == 0 ? " -w"s + to_string(word_distribution(generator)) : ""s) + " seed5"s);
+    }
+    for (const bool parallel : { false, true }) {
+        const string hint = parallel ? "par"s : "seq"s;
+        SearchServer batch("and with"s);
+        prepare(batch);
+        const vector<AddDocumentError> errors = parallel ? batch.AddDocuments(execution::par, documents)
+            : batch.AddDocuments(execution::seq, documents);
+        ASSERT_EQUAL(errors.size(), expected_errors.size());
+        for (size_t i = 0; i < errors.size(); ++i) {
+            AssertEqual(errors[i].index, expected_errors[i].index, hint);
+            AssertEqual(errors[i].document_id, expected_errors[i].document_id, hint);
+            AssertEqual(errors[i].message, expected_errors[i].message, hint);
+        }
+
+        AssertEqual(batch.GetDocumentCount(), one_by_one.GetDocumentCount(), hint);
+        AssertEqual(vector<int>(batch.begin(), batch.end()), vector<int>(one_by_one.begin(), one_by_one.end()), hint);
+        for (const int document_id : one_by_one) {
+            AssertEqual(batch.GetWordFrequencies(document_id), one_by_one.GetWordFrequencies(document_id), hint);
+        }
+        for (const string& query : queries) {
+            AssertSameDocuments(batch.FindTopDocuments(query), one_by_one.FindTopDocuments(query), query);
+            AssertSameDocuments(batch.FindTopDocuments(query, DocumentStatus::BANNED, 20),
+                one_by_one.FindTopDocuments(query, DocumentStatus::BANNED, 20), query);
+            AssertSameDocuments(batch.FindTopDocuments(search_policy::max_score, query, DocumentStatus::ACTUAL, 20),
+                one_by_one.FindTopDocuments(search_policy::max_score, query, DocumentStatus::ACTUAL, 20), query);
+        }
+    }
+}
+
+}  // namespace
+
+void TestSearchServer() {
+    TestRunner tr;
+    RUN_TEST(tr, TestTopDocumentsTieBreakByRating);
+    RUN_TEST(tr, TestTopDocumentsHugeTopK);
+    RUN_TEST(tr, TestMaxScoreMatchesExhaustiveSearch);
+    RUN_TEST(tr, TestMinusWordsExcludeDocuments);
+    RUN_TEST(tr, TestTermWeightsFollowIndexChanges);
+    RUN_TEST(tr, TestFrozenTermWeightsBulkAddIsLinear);
+    RUN_TEST(tr, TestStreamVByteDecodersAgree);
+    RUN_TEST(tr, TestQueryCacheEvictsAfterRehash);
+    RUN_TEST(tr, TestQueryCacheSeparatesPolicies);
+    RUN_TEST(tr, TestRemovedStatusIsNotTombstone);
+    RUN_TEST(tr, TestCompactionKeepsResults);
+    RUN_TEST(tr, TestSnapshotRoundTrip);
+    RUN_TEST(tr, TestSegmentedIndexViewIsStable);
+    RUN_TEST(tr, TestSegmentedIndexMatchesSearchServer);
+    RUN_TEST(tr, TestConcurrentIngestMatchesSequential);
+    RUN_TEST(tr, TestQueryExecutorHonorsTopK);
+    RUN_TEST(tr, TestBatchSearchMatchesFindTopDocuments);
+    RUN_TEST(tr, TestFindDuplicatesMatchesWordSets);
+    RUN_TEST(tr, TestNearDuplicatesMatchBruteForce);
+    RUN_TEST(tr, TestMatchDocumentsMatchesMatchDocument);
+    RUN_TEST(tr, TestRequestQueueMatchesDeque);
+    RUN_TEST(tr, TestRequestQueueConcurrentWindow);
+    RUN_TEST(tr, TestConcurrentMapMatchesMap);
+    RUN_TEST(tr, TestSplitIntoValidWordsMatchesScalar);
+    RUN_TEST(tr, TestSearchServerIsMovable);
+    RUN_TEST(tr, TestRelocatedTermsKeepIssuedWords);
+    RUN_TEST(tr, TestAddDocumentsMatchesAddDocument);
+}
+
+void RunBenchmarks(ostream& out) {
+    // Замеры печатаются под именем функции; параметры — значения по умолчанию из test_example_functions.h
+    const auto run = [&out](const string& name, const auto& benchmark) {
+        out << "--- "s << name << endl;
+        benchmark(out);
+    };
+    run("BenchmarkPostingLayout"s, [](ostream& stream) { BenchmarkPostingLayout(stream); });
+    run("BenchmarkParallelScoring"s, [](ostream& stream) { BenchmarkParallelScoring(stream); });
+    run("BenchmarkConcurrentMap"s, [](ostream& stream) { BenchmarkConcurrentMap(stream); });
+    run("BenchmarkPostingCompression"s, [](ostream& stream) { BenchmarkPostingCompression(stream); });
+    run("BenchmarkTokenizer"s, [](ostream& stream) { BenchmarkTokenizer(stream); });
+    run("BenchmarkQueryCache"s, [](ostream& stream) { BenchmarkQueryCache(stream); });
+    run("BenchmarkRemoveDocuments"s, [](ostream& stream) { BenchmarkRemoveDocuments(stream); });
+    run("BenchmarkTermStorageChurn"s, [](ostream& stream) { BenchmarkTermStorageChurn(stream); });
+    run("BenchmarkAddDocuments"s, [](ostream& stream) { BenchmarkAddDocuments(stream); });
+    run("BenchmarkSnapshot"s, [](ostream& stream) { BenchmarkSnapshot(stream); });
+    run("BenchmarkSegmentedIndex"s, [](ostream& stream) { BenchmarkSegmentedIndex(stream); });
+    run("StressSegmentedIndexViews"s, [](ostream& stream) { StressSegmentedIndexViews(stream); });
+    run("BenchmarkConcurrentAddDocument"s, [](ostream& stream) { BenchmarkConcurrentAddDocument(stream); });
+    run("BenchmarkQueryExecutor"s, [](ostream& stream) { BenchmarkQueryExecutor(stream); });
+    run("BenchmarkBatchQueries"s, [](ostream& stream) { BenchmarkBatchQueries(stream); });
+    run("BenchmarkRemoveDuplicates"s, [](ostream& stream) { BenchmarkRemoveDuplicates(stream); });
+    run("BenchmarkNearDuplicates"s, [](ostream& stream) { BenchmarkNearDuplicates(stream); });
+    run("BenchmarkMatchDocuments"s, [](ostream& stream) { BenchmarkMatchDocuments(stream); });
+    run("BenchmarkRequestQueue"s, [](ostream& stream) { BenchmarkRequestQueue(stream); });
+}
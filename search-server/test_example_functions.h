@@ -0,0 +1,77 @@
+#pragma once
+#include <iostream>
+
+// Проверки поисковой системы на test_framework.h: печатают результат каждой проверки в cerr
+// и завершают программу, если хотя бы одна провалилась. main запускает их перед примером,
+// если программа собрана с SEARCH_SERVER_RUN_TESTS
+void TestSearchServer();
+
+// Все замеры ниже с параметрами по умолчанию, по очереди. main запускает их вместо примера,
+// если программа собрана с SEARCH_SERVER_RUN_BENCHMARKS; сборка должна быть с оптимизацией
+void RunBenchmarks(std::ostream& out);
+
+// Сравнение старой раскладки индекса (map<int, double> на слово) с плоскими
+// отсортированными списками PostingList: занимаемая память и время обхода
+void BenchmarkPostingLayout(std::ostream& out, int document_count = 100000, int words_in_document = 50);
+
+// Последовательный и параллельный поиск по запросам с длинными списками документов
+void BenchmarkParallelScoring(std::ostream& out, int document_count = 200000, int words_in_document = 50);
+
+// Конкурентные инкременты и удаления: ConcurrentMap против прежней реализации
+// (std::map в каждой корзине, корзины вплотную друг к другу)
+void BenchmarkConcurrentMap(std::ostream& out, int operations_per_thread = 1000000);
+
+// Сжатые списки документов: байт на документ и скорость обхода против несжатых,
+// скорость декодирования Stream VByte с SIMD и без
+void BenchmarkPostingCompression(std::ostream& out, int document_count = 200000, int words_in_document = 50);
+
+// Скорость разбиения текста на слова с проверкой символов (МБ/с): прежний SplitIntoWordsView
+// с отдельной проверкой слов против однопроходного SplitIntoValidWords, и скорость AddDocument
+void BenchmarkTokenizer(std::ostream& out, int document_count = 100000, int words_in_document = 50);
+
+// Поиск по перекошенному потоку запросов с кешем результатов и без него
+void BenchmarkQueryCache(std::ostream& out, int document_count = 100000, int query_count = 5000);
+
+// Удаление пятой части документов: по одному через RemoveDocument и пакетом через RemoveDocuments
+void BenchmarkRemoveDocuments(std::ostream& out, int document_count = 200000, int words_in_document = 50);
+
+// Память под слова словаря при постоянном добавлении и удалении документов с новыми словами
+void BenchmarkTermStorageChurn(std::ostream& out, int rounds = 100, int documents_per_round = 10000);
+
+// Загрузка корпуса (МБ/с): AddDocument по одному против пакетного AddDocuments
+void BenchmarkAddDocuments(std::ostream& out, int document_count = 200000, int words_in_document = 50);
+
+// Холодный старт: пересборка индекса через AddDocument против загрузки снимка и первого запроса
+void BenchmarkSnapshot(std::ostream& out, int document_count = 200000, int words_in_document = 50);
+
+// Загрузка вперемешку с удалениями и поиск: SearchServer против SegmentedIndex
+void BenchmarkSegmentedIndex(std::ostream& out, int document_count = 200000, int query_count = 2000);
+
+// Параллельная загрузка SegmentedIndex (МБ/с) из 1, 4, 16 и 32 потоков против однопоточного SearchServer
+void BenchmarkConcurrentAddDocument(std::ostream& out, int document_count = 200000);
+
+// Поиск по представлениям SegmentedIndex из нескольких потоков во время параллельной загрузки и удаления документов.
+// Проверяет, что представление не меняется под читателем; рассчитан на сборку с -fsanitize=thread
+void StressSegmentedIndexViews(std::ostream& out, int document_count = 50000, unsigned reader_count = 4,
+    unsigned writer_count = 4);
+
+// Пакет коротких и длинных запросов: ProcessQueries на execution::par против пула QueryExecutor
+void BenchmarkQueryExecutor(std::ostream& out, int document_count = 100000, int query_count = 5000);
+
+// Пакет запросов из популярных слов: FindTopDocumentsBatch против FindTopDocuments по каждому запросу
+// и ProcessQueries; выдача сравнивается побитово
+void BenchmarkBatchQueries(std::ostream& out, int document_count = 100000, int query_count = 10000);
+
+// Поиск дубликатов по отпечаткам множеств слов против сравнения склеенных слов в set<string>
+void BenchmarkRemoveDuplicates(std::ostream& out, int document_count = 200000);
+
+// Корпус с копиями документов, в которые добавлены одно-два слова: FindNearDuplicates после загрузки
+// и отсев почти дубликатов при загрузке через NearDuplicateFilter
+void BenchmarkNearDuplicates(std::ostream& out, int document_count = 100000);
+
+// Слова запроса в 50 лучших документах выдачи: MatchDocument по каждому документу против MatchDocuments
+void BenchmarkMatchDocuments(std::ostream& out, int document_count = 100000, int query_count = 5000);
+
+// Учёт запросов: прежняя очередь с копиями выдач против кольцевого буфера RequestQueue
+// в одном и нескольких потоках; печатает долю пустых выдач, QPS и перцентили задержки за окно
+void BenchmarkRequestQueue(std::ostream& out, int document_count = 100000, int request_count = 200000);
@@ -0,0 +1,30 @@
+#include "top_documents.h"
+using namespace std;
+
+TopDocuments::TopDocuments(size_t max_count)
+    : max_count_(max_count) {
+    heap_.reserve(min(max_count_, TOP_DOCUMENTS_MAX_RESERVE));
+}
+
+void TopDocuments::Add(const Document& document) {
+    if (heap_.size() < max_count_) {
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+    else if (max_count_ > 0 && IsMoreRelevant(document, heap_.front())) {
+        pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        heap_.back() = document;
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+}
+
+void TopDocuments::Merge(const TopDocuments& other) {
+    for (const Document& document : other.heap_) {
+        Add(document);
+    }
+}
+
+vector<Document> TopDocuments::Release() {
+    sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    return move(heap_);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <vector>
+#include "document.h"
+
+const double MAX_INACCURACY = 1e-6;
+// Сколько мест в куче выделяется заранее: top_k приходит от вызывающего и может быть сколь угодно большим
+constexpr size_t TOP_DOCUMENTS_MAX_RESERVE = 1024;
+
+// Порядок выдачи: по убыванию релевантности, при равной релевантности — по убыванию рейтинга
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < MAX_INACCURACY) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+// Хранит не более max_count лучших документов в куче, на вершине которой худший из них
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t max_count);
+
+    void Add(const Document& document);
+    void Merge(const TopDocuments& other);
+
+    bool IsFull() const {
+        return heap_.size() == max_count_;
+    }
+
+    // Худший из отобранных документов; вызывать только для непустого набора
+    const Document& Worst() const {
+        return heap_.front();
+    }
+
+    // Отобранные документы в порядке выдачи
+    std::vector<Document> Release();
+
+private:
+    size_t max_count_;
+    std::vector<Document> heap_;
+};
+
+inline std::vector<Document> SelectTopDocuments(const std::vector<Document>& documents, size_t max_count) {
+    TopDocuments top(max_count);
+    for (const Document& document : documents) {
+        top.Add(document);
+    }
+    return top.Release();
+}
+
+inline std::vector<Document> SelectTopDocuments(const std::execution::sequenced_policy&,
+    const std::vector<Document>& documents, size_t max_count) {
+    return SelectTopDocuments(documents, max_count);
+}